@@ -14,6 +14,8 @@
 #undef CONFIG_FANCY_UI
 #undef CONFIG_COMPRESS
 #undef CONFIG_DECOMPRESS
+#undef CONFIG_IO_URING
+#undef CONFIG_PERF_COUNTERS
 #undef CONFIG_MULTITHREAD
 #undef CONFIG_FEATURES
 
@@ -11,11 +11,30 @@
 #include "main.h"
 #include "crc.h"
 #include "lc_common.h"
+#ifdef CONFIG_IO_URING
+# include "uring.h"
+#endif
 
 /* Standard definitions */
+/* Default byte window sizes for pipes and terminals, for regular files
+ * and the maximum one can ask for with -B. */
 #define BS_WINDOW_SIZE			(80 * 1024)
+#define BS_FILE_WINDOW_SIZE		(1024 * 1024)
+#define BS_MAX_WINDOW_SIZE		(64 * 1024 * 1024)
 #define BS_BIT_WINDOW			16
 
+/* Holes in sparse inputs smaller than this are read as data. */
+#define BS_MIN_HOLE			(64 * 1024)
+
+/* bs_preallocate() is not asked for more than this many times the
+ * compressed input left, whatever a member header says.  A block of
+ * a run can expand a hundred thousand times, but runs of zeros are
+ * written as holes anyway, not into the space reserved. */
+#define BS_MAX_PREALLOC_RATIO		64
+
+/* Thrown when a stream runs out of input before its end was pushed. */
+#define BS_NEED_INPUT			(-1)
+
 /* Type definitions */
 /*
  * It is a mule thing.
@@ -37,16 +56,49 @@ struct bitstream_st
 {
 	/* Used in every roles */
 	int fd, stdfd;
+	/* The byte window is a buffer of the caller of bzip_buffer()
+	 * or bunzip_buffer() rather than ours.  Streams are memory
+	 * bitstreams whose window is ours and `grow's as needed;
+	 * see bs_open_stream(). */
+	int memory, grow;
 	char const *fname;
+	/* With -v the time spent in bs_fill_byte() or bs_flush_byte()
+	 * is added up in `secs'. */
+	int timed;
+	double secs;
 	u_int8_t *byte_p, *byte_end;
-	u_int8_t byte_window[BS_WINDOW_SIZE];
+	u_int8_t *byte_window, *byte_buf;
+	size_t byte_size;
+#ifdef CONFIG_IO_URING
+	struct uring_st *uring;
+#endif
+#ifdef CONFIG_MULTITHREAD
+	struct bs_thread_st *thread;
+#endif
 
 	/* Input */
 	int eof;
+	off_t fpos, nread;
+	u_int8_t *map;
+	size_t map_size;
+	time_t map_mtime;
+
+	/* When compressing a sparse mapped input the byte window ends
+	 * where the next hole begins, and `hole_end' is where the data
+	 * continues after it. */
+	u_int8_t *hole_end;
 
 	/* Output */
 	int blocked;
 
+	/* Bytes flushed so far; of these only the ones in
+	 * [skip, limit) are written, if `limit' is set.
+	 * `start' is where the output begins in the file. */
+	off_t done, skip, limit;
+	off_t start;
+	/* Where the space bs_preallocate() has reserved ends in the file */
+	off_t reserved;
+
 	/* Bytestream */
 	u_int32_t crc;
 
@@ -60,6 +112,23 @@ extern unsigned bs_fill_byte(struct bitstream_st *bs, int eofok);
 extern void bs_flush_byte(struct bitstream_st *bs);
 extern unsigned bs_fill_bit(struct bitstream_st *bs, int eofok);
 extern void bs_flush_bit(struct bitstream_st *bs);
+extern void bs_align(struct bitstream_st *bs);
+extern void bs_get_bytes(struct bitstream_st *bs, void *buf, size_t size);
+extern void bs_put_bytes(struct bitstream_st *bs,
+	void const *buf, size_t size);
+extern off_t bs_tell_bit(struct bitstream_st const *bs);
+extern off_t bs_output_size(struct bitstream_st const *bs);
+extern void bs_preallocate(struct bitstream_st *bs, off_t size);
+extern off_t bs_input_left(struct bitstream_st const *bs);
+extern void bs_seek_bit(struct bitstream_st *bs, off_t bit);
+extern off_t bs_skip_hole(struct bitstream_st *bs);
+extern void bs_put_zeros(struct bitstream_st *bs, off_t size);
+extern void bs_open_stream(struct bitstream_st *bs, int output);
+extern void bs_stream_push(struct bitstream_st *bs,
+	void const *buf, size_t size);
+extern void bs_stream_mark(struct bitstream_st *bs);
+extern size_t bs_stream_pull(struct bitstream_st *bs,
+	void *buf, size_t size);
 
 /* Global variables */
 extern struct bitstream_st input_bs, output_bs;
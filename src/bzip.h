@@ -10,6 +10,16 @@
 /* The block loader and RLEr */
 #define SPOT_BASIS_STEP		8000
 
+/* Sent in place of the origPtr of a block, which is never zero,
+ * when the block follows as is.  Only members with a trailer
+ * may have such blocks. */
+#define STORED_BLOCK		0x00000000
+#define STORED_LAST_BLOCK	0x80000000
+
+/* Sent before a block which follows a hole in the input, then
+ * the size of the hole as two more words, high word first. */
+#define HOLE_BLOCK		0x40000000
+
 /* Macros */
 /* The DCC95 arithmetic coder */
 #define TWO_TO_THE(n)		(1 << (n))
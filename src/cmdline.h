@@ -7,15 +7,23 @@
 #define OPS_COMPRESS			'f'
 #define OPS_COMPRESS_LEVEL		'b'
 #define OPS_COMPRESS_THREADS		'p'
+#define OPS_SORT_THREADS		'j'
+#define OPS_MEMBER_TRAILER		'M'
+#define OPS_BLOCK_CRC			'e'
 
 #define OPS_DECOMPRESS			'd'
 #define OPS_DECOMPRESS_FRAG		'D'
+#define OPS_INDEX			'i'
+#define OPS_RANGE			'r'
+#define OPS_LIST			'l'
+#define OPS_VERIFY			'x'
 
 /* I/O options */
 #define OPS_OUTPUT			'o'
 #define OPS_STDOUT			'c'
 #define OPS_DEVNULL			'C'
 #define OPS_PERMS			'm'
+#define OPS_WINDOW_SIZE			'B'
 
 #define OPS_TOLERANT			't'
 #define OPS_DONT_TOLERANT		'T'
@@ -29,6 +37,8 @@
 #define OPS_DONT_SYMFOLLOW		'S'
 
 /* Common options */
+#define OPS_VERBOSE			'v'
+#define OPS_STATS_JSON			'J'
 #define OPS_VERSION			'V'
 #define OPS_HELP			'h'
 
@@ -39,15 +49,25 @@ static char const cmdopts[] =
 	OPS_COMPRESS,
 	OPS_COMPRESS_LEVEL,	':',
 	'1', '2', '3', '4', '5', '6', '7', '8', '9',
+#ifdef CONFIG_MULTITHREAD
+	OPS_SORT_THREADS,	':',
+#endif
+	OPS_MEMBER_TRAILER,
+	OPS_BLOCK_CRC,
 
 	OPS_DECOMPRESS,
 	OPS_DECOMPRESS_FRAG,	':',
+	OPS_INDEX,		':',
+	OPS_RANGE,		':',
+	OPS_LIST,
+	OPS_VERIFY,
 
 	/* I/O options */
 	OPS_OUTPUT,		':',
 	OPS_STDOUT,
 	OPS_DEVNULL,
 	OPS_PERMS,		':',
+	OPS_WINDOW_SIZE,	':',
 
 	OPS_TOLERANT,
 	OPS_DONT_TOLERANT,
@@ -61,6 +81,8 @@ static char const cmdopts[] =
 	OPS_DONT_SYMFOLLOW,
 
 	/* Common options */
+	OPS_VERBOSE,
+	OPS_STATS_JSON,
 	OPS_VERSION,
 	OPS_HELP
 };
@@ -75,11 +97,27 @@ static char const msg_usage[] =
 "  -f                   compress input\n"
 "  -1 .. -9\n"
 "  -b <level>           specify compression level (default: 9)\n"
+#ifdef CONFIG_MULTITHREAD
+"  -j <threads>         specify number of sorting threads (default: number\n"
+"                       of processors - 1, at most 4)\n"
+#endif
+"  -M                   record sizes so that -D and -l can seek, store\n"
+"                       incompressible blocks as they are and skip holes\n"
+"                       (older versions can't read such files)\n"
+"  -e                   follow each block by its CRC, so that damage is\n"
+"                       found as soon as the block is written (implies -M)\n"
 "\n"
 #endif
 #ifdef CONFIG_DECOMPRESS
 "  -d                   decompress input\n"
 "  -D                   specify which fragment to decompress (default: all)\n"
+"  -i <file-name>       write the block index of the input to <file-name>;\n"
+"                       with -r read it from there\n"
+"  -r <offset>,<length> decompress only <length> bytes from <offset> (needs\n"
+"                       -i and a regular input file)\n"
+"  -l                   list the fragments of the input\n"
+"  -x                   check the inputs without writing anything, as many\n"
+"                       at a time as there are processors or -j says\n"
 "\n"
 #endif
 "I/O options: (capital letters mean `do not')\n"
@@ -87,6 +125,8 @@ static char const msg_usage[] =
 "  -c                   write resoult to stdout (implies -k)\n"
 "  -C                   do not write result to anywhere (implies -k)\n"
 "  -m <perm>            specify output file permissions (default: 0666)\n"
+"  -B <kbytes>          specify I/O buffer size (default: 1024 for files,\n"
+"                       80 for pipes)\n"
 "\n"
 "  -t, -T               treat most errors nonfatal\n"
 "  -k, -K               keep input files\n"
@@ -95,6 +135,9 @@ static char const msg_usage[] =
 "  -s, -S               follow symlinks\n"
 "\n"
 "Common options:\n"
+"  -v                   report statistics on stderr: how long each stage\n"
+"                       took on each file, and on each block with -vv\n"
+"  -J                   report the statistics as JSON lines (implies -v)\n"
 "  -V                   display version information\n"
 "  -h                   display this text\n"
 "\n"
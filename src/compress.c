@@ -11,12 +11,21 @@
 
 #include <string.h>
 #include <stdio.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 #include "compress.h"
 #include "main.h"
 #include "bzip.h"
 #include "bitstream.h"
+#include "crc.h"
 #include "models.h"
+#include "member.h"
+#include "stats.h"
+#ifdef CONFIG_MULTITHREAD
+# include "threads.h"
+#endif
 #include "lc_common.h"
 
 /* Standard definitions */
@@ -39,25 +48,107 @@ union words_t
 	u_int8_t c[4];
 } __attribute__ ((packed));
 
+/*
+ * A block of RLE-d input and its sorting.  With threads one block
+ * is being filled by the reader, a few are being sorted and one is
+ * being sent.  `error' is the exception the reader caught while
+ * filling it.  `stored' blocks are not sorted but sent as they are.
+ * `hole' is the size of the hole in the input before the block.
+ * `crc' is the CRC of the `length' bytes of input the reader went
+ * through to fill it, which the coder adds to the stream CRC.
+ * With -e `block_crc' is the CRC of the block itself, which is sent
+ * after it.  `stats' is how long each stage took on it.
+ */
+struct block_st
+{
+	union words_t *words;
+	unsigned *zptr;
+	unsigned words_end, size, origPtr;
+	u_int32_t crc, block_crc;
+	off_t hole, length;
+	int finish, error, stored;
+	struct stats_st stats;
+};
+
+#ifdef CONFIG_MULTITHREAD
+/* A sorter thread and its queues */
+struct sorter_st
+{
+	struct worker_st worker;
+	struct ring_st todo, done;
+	struct compress_st *cx;
+};
+#endif
+
+/*
+ * Everything about a compression: where from, where to and how, and
+ * the state of the stages between the blocks.  Compressions with
+ * contexts of their own can run at the same time in different threads.
+ * The block-sorting machinery and the move-to-front coder are not
+ * here: they work on one block at a time, through the thread-local
+ * pointers below, which the thread working on the block sets.
+ * `hole', `ch' and `runLen' are where the RLE reader stopped at
+ * the end of the last block.
+ */
+struct compress_st
+{
+	struct bitstream_st *ibs, *obs;
+	unsigned level, nthreads, sort_threads;
+	int member_trailer, block_crcs;
+	struct stats_st *stats;
+	int block_stats;
+
+	/* The DCC95 arithmetic coder */
+	u_int32_t bigL, bigR;
+	u_int32_t bitsOutstanding;
+	struct models_st models;
+
+	/* The RLE reader */
+	off_t hole;
+	u_int8_t ch;
+	unsigned runLen;
+
+	/* The main driver machinery.  Without threads the blocks
+	 * are sent one by one by compress_block(). */
+#ifdef CONFIG_MULTITHREAD
+	unsigned nblocks, nsorters;
+	struct block_st blocks[MAX_SORT_THREADS + 2];
+	struct sorter_st sorters[MAX_SORT_THREADS];
+	struct ring_st free_blocks;
+	struct worker_st reader;
+#endif
+};
+
 /* Function prototypes */
-static void arithCodeStartEncoding(void);
-static void arithCodeDoneEncoding(void);
-static void write_magic(unsigned clevel, unsigned nthreads);
-static void thread_slave(unsigned blocksize);
+static void arithCodeStartEncoding(struct compress_st *cx);
+static void arithCodeDoneEncoding(struct compress_st *cx);
+static void write_magic(struct compress_st *cx);
+static void thread_slave(struct compress_st *cx);
+static void alloc_block(struct block_st *block, unsigned blocksize);
+static void send_block(struct compress_st *cx, struct block_st *block);
+#ifdef CONFIG_MULTITHREAD
+static unsigned count_sorters(struct compress_st const *cx);
+static void *rle_reader(void *cxp);
+static void *block_sorter(void *sorterp);
+#endif
 
 /* Bitstream machinery */
-static inline int bs_get_byte(void);
-static inline void bs_put_bit(unsigned bit);
+static unsigned bs_refill(struct compress_st *cx, struct block_st *block,
+	u_int8_t const **fromp);
+static inline void bs_put_bit(struct compress_st *cx, unsigned bit);
 
 /* The DCC95 arithmetic coder */
-static inline void arithCodeBitPlusFollow(unsigned bit);
-static inline void arithCodeRenormalize_Encode(void);
-static void putSymbol(struct Model *m, unsigned symbol);
-static void putUInt32(u_int32_t i);
+static inline void arithCodeBitPlusFollow(struct compress_st *cx,
+	unsigned bit);
+static inline void arithCodeRenormalize_Encode(struct compress_st *cx);
+static void putSymbol(struct compress_st *cx, struct Model *m,
+	unsigned symbol);
+static void putUInt32(struct compress_st *cx, u_int32_t i);
 
 /* Move-to-front encoding */
-static inline void sendMTFVal(unsigned n);
-static inline void sendZeroes(unsigned zeroesPending);
+static inline void sendMTFVal(struct compress_st *cx, unsigned n);
+static inline void sendZeroes(struct compress_st *cx,
+	unsigned zeroesPending);
 
 /* Block-sorting machinery */
 static inline int trivialGt(unsigned i1, unsigned i2);
@@ -68,47 +159,137 @@ static inline void stripe(void);
 static inline void sortIt(void);
 
 /* The Reversible Transformation (tm) */
-static inline unsigned getRLEpair(u_int8_t *chp);
+static inline size_t findRun(u_int8_t const *p, size_t n);
+static inline size_t measureRun(u_int8_t const *p, size_t n, u_int8_t ch);
+static inline void copyToWords(union words_t *words, unsigned words_end,
+	u_int8_t const *p, size_t n);
+static inline unsigned putRLEpair(union words_t *words, unsigned words_end,
+	u_int8_t ch, unsigned runLen);
 
 /* The main driver machinery */
-static int loadAndRLEsource(unsigned blocksize);
+static int loadAndRLEsource(struct compress_st *cx, struct block_st *block);
+static void sortBlock(struct compress_st const *cx, struct block_st *block);
+static u_int32_t crcBlock(int finish);
+static int probeBlock(void);
 static void spotBlock(void);
 static unsigned doReversibleTransformation(void);
-static void moveToFrontCodeAndSend(int finish, unsigned origPtr);
+static void moveToFrontCodeAndSend(struct compress_st *cx,
+	int finish, unsigned origPtr);
+static void sendStoredBlock(struct compress_st *cx, int finish);
+static void sendHole(struct compress_st *cx, off_t size);
 
 /* Private variables */
-/* The DCC95 arithmetic coder */
-static u_int32_t bigL, bigR;
-static u_int32_t bitsOutstanding;
-
 /* Move-to-front encoding/decoding */
-static unsigned words_end;
-static union words_t *words = NULL;
+static THREAD_LOCAL unsigned words_end;
+static THREAD_LOCAL union words_t *words = NULL;
 
-/* Block-sorting machinery */
-static unsigned *zptr = NULL;
+/* Block-sorting machinery: `fullGts' counts the calls of fullGt(),
+ * which blow up on repetitive blocks. */
+static THREAD_LOCAL unsigned *zptr = NULL;
+static THREAD_LOCAL unsigned long long fullGts;
+
+/* The main driver machinery: the block of compress_block(),
+ * shared by the contexts compressing in the same thread. */
+static THREAD_LOCAL struct block_st serial;
 
 /* Program code */
 /* Interface functions */
-void compress(void)
+/* Returns a context for compressing as `params' say.  The blocks are
+ * only allocated by the first compress(). */
+struct compress_st *compress_new(struct compress_params_st const *params)
+{
+	struct compress_st *cx;
+
+	cx = NULL;
+	lc_recallocp(&cx, sizeof(*cx));
+	cx->ibs = params->ibs;
+	cx->obs = params->obs;
+	cx->level = params->level;
+	cx->nthreads = params->nthreads;
+	cx->sort_threads = params->sort_threads;
+	cx->member_trailer = params->member_trailer;
+	cx->block_crcs = params->block_crcs;
+	cx->stats = params->stats;
+	cx->block_stats = params->block_stats;
+
+	return cx;
+} /* compress_new */
+
+/* Compresses a member from cx->ibs to cx->obs. */
+void compress(struct compress_st *cx)
 {
-	unsigned clevel, nthreads;
+	compress_start(cx);
+	thread_slave(cx);
+	compress_finish(cx);
+} /* compress */
 
-	clevel = main_runtime.compression_level;
-	nthreads = main_runtime.compress_threads;
+/*
+ * compress() step by step, for those who cannot give us all
+ * the input at once: compress_start() writes the header of the member,
+ * then each compress_block() reads, sorts and sends one block until
+ * it returns nonzero at the end of the input, then compress_finish()
+ * closes the member.  The blocks are compressed in the thread calling
+ * compress_block() and if the input runs out in the middle of one
+ * nothing but cx->ibs is changed, so the step can be tried again
+ * from the same place with more input.
+ */
+void compress_start(struct compress_st *cx)
+{
+	cx->hole = 0;
+	cx->runLen = 0;
 
-	write_magic(clevel, nthreads);
-	initBogusModel();
-	arithCodeStartEncoding();
+	write_magic(cx);
+	initBogusModel(&cx->models);
+	arithCodeStartEncoding(cx);
+} /* compress_start */
 
-	thread_slave(clevel * 100000);
-} /* compress */
+int compress_block(struct compress_st *cx)
+{
+	alloc_block(&serial, cx->level * 100000);
+	serial.finish = loadAndRLEsource(cx, &serial);
+	sortBlock(cx, &serial);
+	send_block(cx, &serial);
+	return serial.finish;
+} /* compress_block */
+
+void compress_finish(struct compress_st *cx)
+{
+	putUInt32(cx, ~cx->ibs->crc);
+	arithCodeDoneEncoding(cx);
+} /* compress_finish */
+
+/* Stops the threads of a compression which failed.  The context
+ * can be used again. */
+void compress_abort(struct compress_st *cx)
+{
+#ifdef CONFIG_MULTITHREAD
+	unsigned i;
+
+	worker_stop(&cx->reader);
+	for (i = 0; i < cx->nsorters; i++)
+		worker_stop(&cx->sorters[i].worker);
+#endif
+} /* compress_abort */
+
+void compress_free(struct compress_st *cx)
+{
+#ifdef CONFIG_MULTITHREAD
+	unsigned i;
+
+	for (i = 0; i < cx->nblocks; i++)
+	{
+		lc_hugefree(&cx->blocks[i].words);
+		lc_hugefree(&cx->blocks[i].zptr);
+	}
+#endif
+	free(cx);
+} /* compress_free */
 
 /* Private functions */
-void write_magic(unsigned clevel, unsigned nthreads)
+void write_magic(struct compress_st *cx)
 {
 	char magic[4];
-
+	int sized;
 	unsigned i, o;
 
 	/* bs_get_byte() cannot be used because bit_window might be
@@ -118,84 +299,280 @@ void write_magic(unsigned clevel, unsigned nthreads)
 	 * to avoid inconsistency, we falled back to this solution. */
 	magic[0] = 'B';
 	magic[1] = 'Z';
-	magic[2] = nthreads > 0 ? 'M' + nthreads : '0';
-	magic[3] = clevel + '0';
+	/* The size of mapped inputs is known in advance. */
+	sized = 0;
+	if (cx->nthreads > 0)
+		magic[2] = 'M' + cx->nthreads;
+	else if (!cx->member_trailer)
+		magic[2] = '0';
+	else if ((sized = cx->ibs->map != NULL) != 0)
+		magic[2] = MEMBER_VERSION_SIZED;
+	else
+		magic[2] = MEMBER_VERSION;
+	if (cx->nthreads == 0 && cx->block_crcs)
+		magic[2] += MEMBER_VERSION_BLOCK_CRC;
+	magic[3] = cx->level + '0';
 	for (i = 0; i < MEMBS_OF(magic); i++)
 		for (o = 8; o > 0; o--)
 		{
-			bs_put_bit((magic[i] & (1 << 7)) != 0);
+			bs_put_bit(cx, (magic[i] & (1 << 7)) != 0);
 			magic[i] <<= 1;
 		}
+
+	if (sized)
+		member_put_header(cx->obs, cx->ibs->map_size);
 } /* write_magic */
 
-void arithCodeStartEncoding(void)
+void arithCodeStartEncoding(struct compress_st *cx)
 {
-	bigL = 0;
-	bigR = TWO_TO_THE(smallB - 1);
-	bitsOutstanding = 0;
+	cx->bigL = 0;
+	cx->bigR = TWO_TO_THE(smallB - 1);
+	cx->bitsOutstanding = 0;
 } /* arithCodeStartEncoding */
 
-void arithCodeDoneEncoding(void)
+void arithCodeDoneEncoding(struct compress_st *cx)
 {
 	u_int32_t i;
 
 	for (i = 1 << smallB; (i >>= 1) > 0; )
-		arithCodeBitPlusFollow(!(bigL & i));
+		arithCodeBitPlusFollow(cx, !(cx->bigL & i));
 } /* arithCodeDoneEncoding */
 
 /*
- * This routine is a part of the not-yet-written multithread support.
+ * Sorts and sends the blocks.  With threads the input is read and
+ * RLE-d by rle_reader() and the blocks are sorted by block_sorter()s
+ * in the background, all we do here is the coding, which has to be
+ * sequential.  The sorters are dealt the blocks in turn and we take
+ * them back in the same order, so the output is the same as if we
+ * did everything ourselves.
  */
-void thread_slave(unsigned blocksize)
+void thread_slave(struct compress_st *cx)
 {
+#ifdef CONFIG_MULTITHREAD
 	int finish;
+	unsigned i;
+	struct block_st *block;
 
-	lc_recallocp(&words, (blocksize + MAX_DENORM_OFFSET)
-		* sizeof(*words));
-	lc_recallocp(&zptr, blocksize * sizeof(*zptr));
+	cx->nsorters = count_sorters(cx);
+	cx->nblocks = cx->nsorters + 2;
+	for (i = 0; i < cx->nblocks; i++)
+		alloc_block(&cx->blocks[i], cx->level * 100000);
 
-	do
+	ring_init(&cx->free_blocks);
+	for (i = 0; i < cx->nblocks; i++)
+		ring_push(&cx->free_blocks, &cx->blocks[i]);
+	for (i = 0; i < cx->nsorters; i++)
 	{
-		unsigned origPtr;
+		struct sorter_st *sorter;
+
+		sorter = &cx->sorters[i];
+		sorter->cx = cx;
+		ring_init(&sorter->todo);
+		ring_init(&sorter->done);
+		worker_start(&sorter->worker, block_sorter, sorter,
+			&sorter->todo, &sorter->done);
+	}
+	worker_start(&cx->reader, rle_reader, cx, &cx->free_blocks, NULL);
 
-		finish = loadAndRLEsource(blocksize);
-		spotBlock();
-		origPtr = doReversibleTransformation();
-		moveToFrontCodeAndSend(finish, origPtr);
+	i = 0;
+	do
+	{
+		block = ring_pop(&cx->sorters[i++ % cx->nsorters].done);
+		assert(block != NULL);
+		if (block->error)
+			/* It has been reported already. */
+			throw_exception(block->error);
+
+		finish = block->finish;
+		send_block(cx, block);
+		ring_push(&cx->free_blocks, block);
 	} while (!finish);
 
-	putUInt32(~input_bs.crc);
-	arithCodeDoneEncoding();
+	worker_join(&cx->reader);
+	for (i = 0; i < cx->nsorters; i++)
+	{
+		worker_join(&cx->sorters[i].worker);
+		ring_destroy(&cx->sorters[i].todo);
+		ring_destroy(&cx->sorters[i].done);
+	}
+	ring_destroy(&cx->free_blocks);
+#else
+	while (!compress_block(cx))
+		;
+#endif
 } /* thread_slave */
 
+/* Makes room in `block' for `blocksize' bytes of input.  The arrays
+ * are only reallocated if they were last used for smaller blocks. */
+void alloc_block(struct block_st *block, unsigned blocksize)
+{
+	if (!block->words || blocksize > block->size)
+	{
+		lc_hugeallocp(&block->words, (blocksize + MAX_DENORM_OFFSET)
+			* sizeof(*words), "words");
+		lc_hugeallocp(&block->zptr, blocksize * sizeof(*zptr),
+			"zptr");
+	}
+	block->size = blocksize;
+} /* alloc_block */
+
+/* Codes a sorted `block' and adds its input to the stream CRC. */
+void send_block(struct compress_st *cx, struct block_st *block)
+{
+	off_t out;
+	double start, written;
+	struct perf_st perf;
+
+	start = written = 0;
+	out = 0;
+	if (cx->stats)
+	{
+		start = stats_now();
+		written = cx->obs->secs;
+		out = bs_output_size(cx->obs);
+		perf_start(&perf);
+	}
+
+	words = block->words;
+	zptr = block->zptr;
+	words_end = block->words_end;
+	cx->ibs->crc = crc_combine(crc_zeros(cx->ibs->crc, block->hole),
+		block->crc, block->length);
+	if (block->hole)
+		sendHole(cx, block->hole);
+	if (block->stored)
+		sendStoredBlock(cx, block->finish);
+	else
+		moveToFrontCodeAndSend(cx, block->finish, block->origPtr);
+	if (cx->block_crcs)
+		putUInt32(cx, ~block->block_crc);
+
+	if (cx->stats)
+	{	/* What the coder waited for the writer is not its own. */
+		struct stats_st *stats;
+
+		stats = &block->stats;
+		perf_stop(&perf, stats->counts[STATS_CODE]);
+		written = cx->obs->secs - written;
+		stats->secs[STATS_CODE] = stats_now() - start - written;
+		stats->secs[STATS_WRITE] = written;
+		stats->in = block->hole + block->length;
+		stats->out = bs_output_size(cx->obs) - out;
+		stats->blocks = 1;
+		stats_add(cx->stats, stats);
+		if (cx->block_stats)
+			stats_report(cx->ibs->fname, cx->stats->blocks,
+				stats, 0);
+	}
+} /* send_block */
+
+#ifdef CONFIG_MULTITHREAD
+/* Returns what -j says or one less than the number of processors,
+ * the reader and the coder taking the last one. */
+unsigned count_sorters(struct compress_st const *cx)
+{
+	long ncpus;
+
+	if (cx->sort_threads)
+		return cx->sort_threads;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus <= 2)
+		return 1;
+	return MIN(ncpus - 1, DFLT_SORT_THREADS);
+} /* count_sorters */
+
+/* Fills the free blocks until the end of input and deals them
+ * to the sorters. */
+void *rle_reader(void *cxp)
+{
+	int error;
+	unsigned i;
+	jmp_buf handler;
+	struct compress_st *cx;
+	struct block_st *volatile block;
+	unsigned volatile next;
+
+	cx = cxp;
+	next = 0;
+	block = NULL;
+	if ((error = setjmp(handler)) != 0)
+	{	/* Let the main thread fail. */
+		block->error = error;
+		ring_push(&cx->sorters[next % cx->nsorters].todo, block);
+		goto out;
+	}
+	catch_exceptions(&handler);
+
+	while ((block = ring_pop(&cx->free_blocks)) != NULL)
+	{
+		int finish;
+
+		/* `block' is not ours anymore after we've dealt it. */
+		block->error = 0;
+		block->finish = finish = loadAndRLEsource(cx, block);
+		ring_push(&cx->sorters[next++ % cx->nsorters].todo, block);
+		if (finish)
+			break;
+	}
+
+out:
+	for (i = 0; i < cx->nsorters; i++)
+		ring_push(&cx->sorters[i].todo, NULL);
+	return NULL;
+} /* rle_reader */
+
+/* Sorts the blocks dealt to `sorterp' until the reader is done. */
+void *block_sorter(void *sorterp)
+{
+	struct sorter_st *sorter;
+	struct block_st *block;
+
+	sorter = sorterp;
+	while ((block = ring_pop(&sorter->todo)) != NULL)
+	{
+		if (!block->error)
+			sortBlock(sorter->cx, block);
+		ring_push(&sorter->done, block);
+	}
+
+	return NULL;
+} /* block_sorter */
+#endif /* CONFIG_MULTITHREAD */
+
 /*------------------------------------------------------*/
 /* Bitstream machinery					*/
 /*------------------------------------------------------*/
-int bs_get_byte(void)
+/* Adds the input window from *fromp on to the CRC of `block' before
+ * it's refilled and points *fromp at the new one.  Returns the number
+ * of bytes read. */
+unsigned bs_refill(struct compress_st *cx, struct block_st *block,
+	u_int8_t const **fromp)
 {
-	u_int8_t c;
+	unsigned n;
+	struct bitstream_st *ibs;
 
-	assert(INRANGE(input_bs.byte_p,
-		input_bs.byte_window, input_bs.byte_end));
+	ibs = cx->ibs;
+	block->crc = crc_buffer(block->crc, *fromp, ibs->byte_p - *fromp);
+	block->length += ibs->byte_p - *fromp;
+	n = bs_fill_byte(ibs, 1);
+	*fromp = ibs->byte_p;
 
-	if (input_bs.byte_p == input_bs.byte_end
-			&& !bs_fill_byte(&input_bs, 1))
-		return -1;
-	c = *input_bs.byte_p++;
-	updateCRC(input_bs.crc, c);
-	return c;
-} /* bs_get_byte */
+	return n;
+} /* bs_refill */
 
-void bs_put_bit(unsigned bit)
+void bs_put_bit(struct compress_st *cx, unsigned bit)
 {
-	assert(INRANGE(output_bs.bit_p,
-		output_bs.bit_window, output_bs.bit_end));
+	struct bitstream_st *obs;
 
-	if (output_bs.bit_p == output_bs.bit_end)
-		bs_flush_bit(&output_bs);
+	obs = cx->obs;
+	assert(INRANGE(obs->bit_p, obs->bit_window, obs->bit_end));
+
+	if (obs->bit_p == obs->bit_end)
+		bs_flush_bit(obs);
 
 	assert((bit & ~1) == 0);
-	*output_bs.bit_p++ = bit;
+	*obs->bit_p++ = bit;
 } /* bs_put_bit */
 
 /*------------------------------------------------------*/
@@ -221,35 +598,47 @@ void bs_put_bit(unsigned bit)
 /* aboutthe long-term architectural benefit of that	*/
 /* approach.  I could be wrong.				*/
 /*------------------------------------------------------*/
-void arithCodeBitPlusFollow(unsigned bit)
+void arithCodeBitPlusFollow(struct compress_st *cx, unsigned bit)
 {
-	bs_put_bit(!bit);
-	for (; bitsOutstanding > 0; bitsOutstanding--)
-		bs_put_bit(bit);
+	bs_put_bit(cx, !bit);
+	for (; cx->bitsOutstanding > 0; cx->bitsOutstanding--)
+		bs_put_bit(cx, bit);
 } /* arithCodeBitPlusFollow */
 
-void arithCodeRenormalize_Encode(void)
+/* Works on a copy of the registers, which the compiler couldn't keep
+ * in registers otherwise, what with all the bytes we write. */
+void arithCodeRenormalize_Encode(struct compress_st *cx)
 {
+	u_int32_t bigL, bigR;
+
+	bigL = cx->bigL;
+	bigR = cx->bigR;
 	for (; bigR <= TWO_TO_THE(smallB - 2); bigL <<=1, bigR <<= 1)
 		if (bigL + bigR <= TWO_TO_THE(smallB - 1))
 		{
-			arithCodeBitPlusFollow(1);
+			arithCodeBitPlusFollow(cx, 1);
 		} else if (bigL >= TWO_TO_THE(smallB - 1))
 		{
 			bigL -= TWO_TO_THE(smallB - 1);
-			arithCodeBitPlusFollow(0);
+			arithCodeBitPlusFollow(cx, 0);
 		} else
 		{
 			bigL -= TWO_TO_THE(smallB - 2);
-			bitsOutstanding++;
+			cx->bitsOutstanding++;
 		}
+	cx->bigL = bigL;
+	cx->bigR = bigR;
 } /* arithCodeRenormalize_Encode */
 
-void putSymbol(struct Model *m, unsigned symbol)
+void putSymbol(struct compress_st *cx, struct Model *m, unsigned symbol)
 {
 	unsigned const *f;
+	u_int32_t bigL, bigR;
 	u_int32_t smallL, smallH, smallT, smallR, smallR_x_smallL;
 
+	bigL = cx->bigL;
+	bigR = cx->bigR;
+
 	assert(TWO_TO_THE(smallB - 2) < bigR);
 	assert(bigR <= TWO_TO_THE(smallB - 1));
 	assert(bigL < TWO_TO_THE(smallB) - TWO_TO_THE(smallB - 2));
@@ -266,38 +655,39 @@ void putSymbol(struct Model *m, unsigned symbol)
 	smallR = bigR / smallT;
 	smallR_x_smallL = smallR * smallL;
 
-	bigL += smallR_x_smallL;
+	cx->bigL = bigL + smallR_x_smallL;
 	if (smallH < smallT)
-		bigR = smallR * *f;
+		cx->bigR = smallR * *f;
 	else
-		bigR -= smallR_x_smallL;
+		cx->bigR = bigR - smallR_x_smallL;
 
-	arithCodeRenormalize_Encode();
-	assert(bitsOutstanding <= MAX_BITS_OUTSTANDING);
+	arithCodeRenormalize_Encode(cx);
+	assert(cx->bitsOutstanding <= MAX_BITS_OUTSTANDING);
 
 	updateModel(m, symbol);
 } /* putSymbol */
 
-void putUInt32(u_int32_t i)
+void putUInt32(struct compress_st *cx, u_int32_t i)
 {
-	putSymbol(&model_bogus, (i & 0xFF000000) >> 24);
-	putSymbol(&model_bogus, (i & 0xFF0000) >> 16);
-	putSymbol(&model_bogus, (i & 0xFF00) >>  8);
-	putSymbol(&model_bogus, (i & 0xFF));
+	putSymbol(cx, &cx->models.bogus, (i & 0xFF000000) >> 24);
+	putSymbol(cx, &cx->models.bogus, (i & 0xFF0000) >> 16);
+	putSymbol(cx, &cx->models.bogus, (i & 0xFF00) >>  8);
+	putSymbol(cx, &cx->models.bogus, (i & 0xFF));
 } /* putUInt32 */
 
 /*------------------------------------------------------*/
 /* Move-to-front encoding/decoding			*/
 /*------------------------------------------------------*/
-void sendMTFVal(unsigned n)
+void sendMTFVal(struct compress_st *cx, unsigned n)
 {
 	assert(INRANGE(n, 2, 255));
 
-	putSymbol(&models[MODEL_BASIS], MTFVals_encode[n].v);
-	putSymbol(MTFVals_encode[n].m, MTFVals_encode[n].n);
+	putSymbol(cx, &cx->models.m[MODEL_BASIS], MTFVals_encode[n].v);
+	putSymbol(cx, &cx->models.m[MTFVals_encode[n].model],
+		MTFVals_encode[n].n);
 } /* sendMTFVal */
 
-void sendZeroes(unsigned zeroesPending)
+void sendZeroes(struct compress_st *cx, unsigned zeroesPending)
 {
 	unsigned *bp, bitsToSend[BITS_OF(zeroesPending)];;
 
@@ -314,7 +704,7 @@ void sendZeroes(unsigned zeroesPending)
 	do
 	{
 		bp--;
-		putSymbol(&models[MODEL_BASIS], *bp);
+		putSymbol(cx, &cx->models.m[MODEL_BASIS], *bp);
 	} while (bp > bitsToSend);
 } /* sendZeroes */
 
@@ -387,6 +777,7 @@ int fullGt(unsigned i1, unsigned i2)
 
 	assert(words_end >= 4 * NUM_FULLGT_UNROLLINGS);
 
+	fullGts++;
 	if (i1 == i2)
 		return 0;
 	i1orig = i1;
@@ -632,81 +1023,397 @@ void sortIt(void)
 /*------------------------------------------------------*/
 /* The Reversible Transformation (tm)			*/
 /*------------------------------------------------------*/
-unsigned getRLEpair(u_int8_t *chp)
+/* Returns the index of the first of the `n' bytes at `p' which is
+ * the same as the next one, or n - 1. */
+size_t findRun(u_int8_t const *p, size_t n)
 {
-	static int ch = -1;
-	static int inited = 0;
+	size_t i;
 
-	unsigned runLength;
+	i = 0;
+#ifdef __SSE2__
+	for (; i + 16 < n; i += 16)
+	{
+		unsigned mask;
 
-	if (ch < 0)
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+			_mm_loadu_si128((__m128i const *)&p[i]),
+			_mm_loadu_si128((__m128i const *)&p[i + 1])));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i + 1 < n; i++)
+		if (p[i] == p[i + 1])
+			return i;
+
+	return n - 1;
+} /* findRun */
+
+/* Returns how many of the `n' bytes at `p' are `ch' in a row. */
+size_t measureRun(u_int8_t const *p, size_t n, u_int8_t ch)
+{
+	size_t i;
+
+	i = 0;
+#ifdef __SSE2__
 	{
-		if (inited)
-		{
-			inited = 0;
-			return 0;
-		}
+		__m128i cc;
 
-		inited = 1;
-		ch = bs_get_byte();
-		if (ch < 0)
+		cc = _mm_set1_epi8(ch);
+		for (; i + 16 <= n; i += 16)
 		{
-			inited = 0;
-			return 0;
+			unsigned mask;
+
+			mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128((__m128i const *)&p[i]),
+				cc)) ^ 0xFFFF;
+			if (mask)
+				return i + __builtin_ctz(mask);
 		}
 	}
+#endif
+	for (; i < n && p[i] == ch; i++)
+		;
 
-	*chp = ch;
-	runLength = 0;
-	do
+	return i;
+} /* measureRun */
+
+/* Copies the `n' bytes at `p' into the first bytes of the words
+ * from `words_end' on. */
+void copyToWords(union words_t *words, unsigned words_end,
+	u_int8_t const *p, size_t n)
+{
+	size_t i;
+
+	i = 0;
+#if defined(__SSE2__) && BYTE_ORDER == LITTLE_ENDIAN
 	{
-		runLength++;
-		ch = bs_get_byte();
-	} while (ch == *chp && runLength < 255);
+		__m128i zero;
 
-	return runLength;
-} /* getRLEpair */
+		/* Interleaving with zeros twice puts every byte at the
+		 * top of a word, which is where GETFIRST() looks. */
+		zero = _mm_setzero_si128();
+		for (; i + 16 <= n; i += 16)
+		{
+			__m128i v, lo, hi;
+			__m128i *to;
+
+			v = _mm_loadu_si128((__m128i const *)&p[i]);
+			lo = _mm_unpacklo_epi8(zero, v);
+			hi = _mm_unpackhi_epi8(zero, v);
+
+			to = (__m128i *)&words[words_end + i];
+			_mm_storeu_si128(&to[0], _mm_unpacklo_epi16(zero, lo));
+			_mm_storeu_si128(&to[1], _mm_unpackhi_epi16(zero, lo));
+			_mm_storeu_si128(&to[2], _mm_unpacklo_epi16(zero, hi));
+			_mm_storeu_si128(&to[3], _mm_unpackhi_epi16(zero, hi));
+		}
+	}
+#endif
+	for (; i < n; i++)
+		SETFIRST(words_end + i, p[i]);
+} /* copyToWords */
+
+/* Puts a run of `runLen' `ch's to the words from `words_end' on
+ * and returns the new end. */
+unsigned putRLEpair(union words_t *words, unsigned words_end,
+	u_int8_t ch, unsigned runLen)
+{
+	assert(INRANGE(runLen, 1, 255));
+	switch (runLen)
+	{
+	default:
+		SETFIRST(words_end++, ch);
+		SETFIRST(words_end++, ch);
+		SETFIRST(words_end++, ch);
+		SETFIRST(words_end++, ch);
+		SETFIRST(words_end++, runLen - 4);
+		break;
+
+	case 3:
+		SETFIRST(words_end++, ch);
+	case 2:                
+		SETFIRST(words_end++, ch);
+	case 1:                
+		SETFIRST(words_end++, ch);
+		break;
+	} /* switch */
+
+	return words_end;
+} /* putRLEpair */
 
 /*------------------------------------------------------*/
 /* The main driver machinery 				*/
 /*------------------------------------------------------*/
-int loadAndRLEsource(unsigned blocksize)
+/*
+ * Fills `block' with the RLE-d input: runs of 4 to 255 equal bytes
+ * become the first 4 of them and the number of the rest.  Rather than
+ * going byte by byte the input window is scanned for the next pair of
+ * equal bytes, and the bytes up to it are copied as they are.  `ch'
+ * and `runLen' is the run we are in the middle of at the end of the
+ * window or of the block.  Blocks end at the first run which starts
+ * past `last'; the decoder doesn't care, but the output shouldn't
+ * change.
+ */
+int loadAndRLEsource(struct compress_st *cx, struct block_st *block)
 {
+	/* The hole we've run into at the end of the last block
+	 * and the run we've been in the middle of. */
+	off_t hole;
+	u_int8_t ch;
+	unsigned runLen;
+
+	/* The macros work on these, which may not be
+	 * the block being sorted. */
+	union words_t *words;
+	unsigned words_end, last;
+	u_int8_t const *crc_from;
+	int finish;
+	struct bitstream_st *ibs;
+	double start, read;
+	struct perf_st perf;
+
+	ibs = cx->ibs;
+	start = read = 0;
+	if (cx->stats)
+	{
+		start = stats_now();
+		read = ibs->secs;
+		perf_start(&perf);
+	}
+
+	ch = cx->ch;
+	runLen = cx->runLen;
+	words = block->words;
+	block->hole = cx->hole;
+	hole = 0;
+
+	/* The CRC is taken of what we've been through of the window
+	 * when it's refilled or we're done with this block.  It's only
+	 * the block's, so the reader needn't wait for the coder. */
+	block->crc = ~0;
+	block->length = 0;
+	crc_from = ibs->byte_p;
+
 	/* 20 is just a paranoia constant */
-	for (words_end = 0; words_end <= blocksize - 20; )
+	last = block->size - 20;
+	for (finish = 0, words_end = 0; ; )
 	{
-		u_int8_t ch;
-		unsigned runLen;
+		u_int8_t const *p;
+		size_t avail, n;
+
+		if (ibs->byte_p == ibs->byte_end
+			&& !bs_refill(cx, block, &crc_from))
+		{	/* The end of the input or just of the data before
+			 * a hole, which has to go before a block. */
+			if (words_end > last)
+				break;
+			if (runLen > 0)
+			{
+				words_end = putRLEpair(words, words_end,
+					ch, runLen);
+				runLen = 0;
+				continue;
+			}
 
-		runLen = getRLEpair(&ch);
-		assert(runLen <= 255);
-		switch (runLen)
-		{
-		default:
-			SETFIRST(words_end++, ch);
-			SETFIRST(words_end++, ch);
-			SETFIRST(words_end++, ch);
-			SETFIRST(words_end++, ch);
-			SETFIRST(words_end++, runLen - 4);
-			break;
+			if ((hole = bs_skip_hole(ibs)) > 0)
+			{	/* The coder adds it to the CRC. */
+				crc_from = ibs->byte_p;
+				if (words_end > 0)
+					break;
 
-		case 3:
-			SETFIRST(words_end++, ch);
-		case 2:                
-			SETFIRST(words_end++, ch);
-		case 1:                
-			SETFIRST(words_end++, ch);
-			break;
+				block->hole += hole;
+				hole = 0;
+				continue;
+			}
 
-		case 0:
 			SETFIRST(words_end++, 42);
-			return 1;
-		} /* switch */
+			finish = 1;
+			break;
+		}
+
+		p = ibs->byte_p;
+		avail = ibs->byte_end - p;
+		if (runLen > 0)
+		{	/* It may go on in the next window. */
+			n = measureRun(p, MIN(avail, 255 - runLen), ch);
+			ibs->byte_p += n;
+			runLen += n;
+			if (n == avail && runLen < 255)
+				continue;
+
+			if (words_end > last)
+				break;
+			words_end = putRLEpair(words, words_end, ch, runLen);
+			runLen = 0;
+			continue;
+		}
+
+		/* The bytes before the next run are runs of one. */
+		if (words_end > last)
+			break;
+		n = findRun(p, MIN(avail, (size_t)(last - words_end) + 2));
+		copyToWords(words, words_end, p, n);
+		words_end += n;
+		ibs->byte_p += n;
+
+		if (words_end <= last)
+		{	/* Start the next one. */
+			ch = *ibs->byte_p++;
+			runLen = 1;
+		}
 	} /* for */
 
-	return 0;
+	block->crc = crc_buffer(block->crc, crc_from,
+		ibs->byte_p - crc_from);
+	block->length += ibs->byte_p - crc_from;
+	block->words_end = words_end;
+
+	cx->hole = hole;
+	cx->ch = ch;
+	cx->runLen = runLen;
+
+	memset(&block->stats, 0, sizeof(block->stats));
+	if (cx->stats)
+	{	/* With threads only the reader reads `ibs'. */
+		read = ibs->secs - read;
+		block->stats.secs[STATS_RLE] = stats_now() - start - read;
+		block->stats.secs[STATS_READ] = read;
+		perf_stop(&perf, block->stats.counts[STATS_RLE]);
+	}
+
+	return finish;
 } /* loadAndRLEsource */
 
+/* Points the sorting machinery at `block' and sorts it. */
+void sortBlock(struct compress_st const *cx, struct block_st *block)
+{
+	double start;
+	struct perf_st perf;
+
+	words = block->words;
+	zptr = block->zptr;
+	words_end = block->words_end;
+
+	start = 0;
+	if (cx->stats)
+	{
+		start = stats_now();
+		perf_start(&perf);
+	}
+	fullGts = 0;
+
+	/* Before spotBlock() changes it. */
+	if (cx->block_crcs)
+		block->block_crc = crcBlock(block->finish);
+
+	/* Older decoders don't know about stored blocks. */
+	if (!(block->stored = cx->member_trailer && probeBlock()))
+	{
+		spotBlock();
+		block->origPtr = doReversibleTransformation();
+	}
+
+	if (cx->stats)
+	{
+		perf_stop(&perf, block->stats.counts[STATS_SORT]);
+		block->stats.secs[STATS_SORT] = stats_now() - start;
+		block->stats.fullgts = fullGts;
+	}
+} /* sortBlock */
+
+/*
+ * Returns the CRC of what the decoder will make of the block: its
+ * bytes with the runs expanded as unRLEandDump() does, but without
+ * the sentinel of the last block.  The bytes are gathered into a
+ * buffer, so the CRC can be taken of more than one at a time.
+ */
+u_int32_t crcBlock(int finish)
+{
+	int chPrev;
+	unsigned i, n, end, count;
+	u_int32_t crc;
+	u_int8_t buf[4096 + 255];
+
+	crc = ~0;
+	end = finish ? words_end - 1 : words_end;
+	count = n = 0;
+	chPrev = -1;
+	for (i = 0; i < end; i++)
+	{
+		u_int8_t ch;
+
+		if (n >= 4096)
+		{
+			crc = crc_buffer(crc, buf, n);
+			n = 0;
+		}
+
+		buf[n++] = ch = GETFIRST(i);
+		if (ch != chPrev)
+		{
+			chPrev = ch;
+			count = 1;
+			continue;
+		}
+
+		if (++count < 4)
+			continue;
+
+		/* The length of the rest of the run follows. */
+		if (++i < end)
+		{
+			memset(&buf[n], ch, GETFIRST(i));
+			n += GETFIRST(i);
+		}
+		count = 0;
+	} /* for */
+
+	return crc_buffer(crc, buf, n);
+} /* crcBlock */
+
+/*
+ * Tells whether the block looks like compressed or encrypted data,
+ * which we could only make bigger.  Two things have to hold: the bytes
+ * are so evenly distributed that an order-0 coder would save less
+ * than about 0.02 bit a byte, and hardly any 4-byte strings recur,
+ * so the sorting wouldn't find any context either.  Both are cheap
+ * compared to the sorting.
+ */
+int probeBlock(void)
+{
+	u_int32_t gram, seen[1 << 14];
+	unsigned i, freq[256], repeats;
+	u_int64_t sumsq;
+
+	memset(freq, 0, sizeof(freq));
+	for (i = 0; i < words_end; i++)
+		freq[GETFIRST(i)]++;
+
+	/* The chi-square statistic is 256 * sumsq / n - n, and the
+	 * order-0 gain is about chi2 / (2 * n * ln 2) bits a byte. */
+	sumsq = 0;
+	for (i = 0; i < MEMBS_OF(freq); i++)
+		sumsq += (u_int64_t)freq[i] * freq[i];
+	if (256 * 36 * sumsq >= (u_int64_t)words_end * words_end * 37)
+		return 0;
+
+	memset(seen, 0, sizeof(seen));
+	gram = repeats = 0;
+	for (i = 0; i < words_end; i++)
+	{
+		u_int32_t *slot;
+
+		gram = (gram << 8) | GETFIRST(i);
+		slot = &seen[(gram * 2654435761U) >> (32 - 14)];
+		if (*slot == gram)
+			repeats++;
+		*slot = gram;
+	}
+
+	return repeats * 64 < words_end;
+} /* probeBlock */
+
 void spotBlock(void)
 {
 	int delta;
@@ -761,13 +1468,14 @@ unsigned doReversibleTransformation(void)
 	panic("doReversibleTransformation");
 } /* doReversibleTransformation */
 
-void moveToFrontCodeAndSend(int finish, unsigned origPtr)
+void moveToFrontCodeAndSend(struct compress_st *cx,
+	int finish, unsigned origPtr)
 {
 	char yy[256];
 	unsigned i, zeroesPending;
 
-	putUInt32(finish ? -(origPtr + 1) : origPtr + 1);
-	initModels();
+	putUInt32(cx, finish ? -(origPtr + 1) : origPtr + 1);
+	initModels(&cx->models);
 
 	for (i = 0; i < 256; i++)
 		yy[i] = i;
@@ -787,7 +1495,7 @@ void moveToFrontCodeAndSend(int finish, unsigned origPtr)
 		switch (zeroesPending)
 		{
 		default:
-			sendZeroes(zeroesPending);
+			sendZeroes(cx, zeroesPending);
 			zeroesPending = 0;
 		case 0:
 			break;
@@ -798,7 +1506,7 @@ void moveToFrontCodeAndSend(int finish, unsigned origPtr)
 			yy[1] = yy[0];
 			yy[0] = ll_i;
 
-			putSymbol(&models[MODEL_BASIS], VAL_ONE);
+			putSymbol(cx, &cx->models.m[MODEL_BASIS], VAL_ONE);
 		} else
 		{
 			unsigned j;
@@ -814,13 +1522,50 @@ void moveToFrontCodeAndSend(int finish, unsigned origPtr)
 			memmove(&yy[1], &yy[0], j);
 			yy[0] = ll_i;
 
-			sendMTFVal(j);
+			sendMTFVal(cx, j);
 		} /* if */
 	} /* for */
 
 	if (zeroesPending)
-		sendZeroes(zeroesPending);
-	putSymbol(&models[MODEL_BASIS], VAL_EOB);
+		sendZeroes(cx, zeroesPending);
+	putSymbol(cx, &cx->models.m[MODEL_BASIS], VAL_EOB);
 } /* moveToFrontCodeAndSend */
 
+/*
+ * Interrupts the arithmetic coding and sends the block as it is:
+ * its length and its bytes, on a byte boundary.  The decoder reads
+ * just as many bits as we write, so it can follow us.
+ */
+void sendStoredBlock(struct compress_st *cx, int finish)
+{
+	unsigned i, n;
+	u_int8_t buf[4096];
+
+	putUInt32(cx, finish ? STORED_LAST_BLOCK : STORED_BLOCK);
+	arithCodeDoneEncoding(cx);
+	bs_align(cx->obs);
+
+	lc_put_be(buf, words_end, 4);
+	bs_put_bytes(cx->obs, buf, 4);
+	for (i = 0; i < words_end; i += n)
+	{
+		unsigned j;
+
+		n = MIN(words_end - i, sizeof(buf));
+		for (j = 0; j < n; j++)
+			buf[j] = GETFIRST(i + j);
+		bs_put_bytes(cx->obs, buf, n);
+	}
+
+	arithCodeStartEncoding(cx);
+} /* sendStoredBlock */
+
+/* Tells the decoder to put `size' zeros before the next block. */
+void sendHole(struct compress_st *cx, off_t size)
+{
+	putUInt32(cx, HOLE_BLOCK);
+	putUInt32(cx, (u_int64_t)size >> 32);
+	putUInt32(cx, size);
+} /* sendHole */
+
 /* End of compress.c */
@@ -1,5 +1,11 @@
 /*
  * crc.c
+ *
+ * Besides the byte-wise updateCRC() buffers can be checksummed
+ * 16 bytes at a time with the slice-by-16 tables, or, on x86 CPUs
+ * which have it, with carry-less multiplication.  The CRC is not
+ * reflected, so the bytes are taken most significant bit first and
+ * the multiplier works on byte-swapped registers.
  */
 
 /* Include files */
@@ -7,7 +13,21 @@
 
 #include <sys/types.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+# define CONFIG_CRC_CLMUL
+# include <immintrin.h>
+#endif
+
 #include "crc.h"
+#include "lc_common.h"
+
+/* Function prototypes */
+static u_int32_t crc_slice16(u_int32_t crc, u_int8_t const *p, size_t len);
+#ifdef CONFIG_CRC_CLMUL
+static u_int32_t crc_clmul(u_int32_t crc, u_int8_t const *p, size_t len)
+	__attribute__ ((target("pclmul,ssse3")));
+#endif
+static u_int32_t crc_multiply(u_int32_t a, u_int32_t b);
 
 /* Global variable definitions */
 u_int32_t const crc32Table[] =
@@ -78,4 +98,200 @@ u_int32_t const crc32Table[] =
 	0xBCB4666D, 0xB8757BDA, 0xB5365D03, 0xB1F740B4
 };
 
+/* Private variables */
+/* crc_slices[k][b] is the CRC of `b' followed by `k' zeros. */
+static u_int32_t crc_slices[16][256];
+
+#ifdef CONFIG_CRC_CLMUL
+/* x^(128 + 64), x^128, x^(512 + 64) and x^512 modulo the polynomial
+ * for folding 16 or 64 bytes ahead, and whether we can. */
+static u_int64_t crc_fold1[2], crc_fold4[2];
+static int crc_has_clmul;
+#endif
+
+/* Program code */
+/* Interface functions */
+/* Fills the tables and sees what the CPU can do.  Must be called
+ * before crc_buffer(). */
+void crc_init(void)
+{
+	unsigned k, b;
+
+	for (b = 0; b < 256; b++)
+		crc_slices[0][b] = crc32Table[b];
+	for (k = 1; k < MEMBS_OF(crc_slices); k++)
+		for (b = 0; b < 256; b++)
+		{
+			u_int32_t prev;
+
+			prev = crc_slices[k - 1][b];
+			crc_slices[k][b] = (prev << 8)
+				^ crc32Table[prev >> 24];
+		}
+
+#ifdef CONFIG_CRC_CLMUL
+	/* crc32Table[1] is x^32 modulo the polynomial. */
+	crc_fold1[1] = crc_zeros(crc32Table[1], (128 + 64 - 32) / 8);
+	crc_fold1[0] = crc_zeros(crc32Table[1], (128 - 32) / 8);
+	crc_fold4[1] = crc_zeros(crc32Table[1], (512 + 64 - 32) / 8);
+	crc_fold4[0] = crc_zeros(crc32Table[1], (512 - 32) / 8);
+
+	__builtin_cpu_init();
+	crc_has_clmul = __builtin_cpu_supports("pclmul")
+		&& __builtin_cpu_supports("ssse3");
+#endif
+} /* crc_init */
+
+/*
+ * Returns what `crc' becomes after `n' zero bytes.  Each of them
+ * multiplies it by x^8 modulo the polynomial, so it's enough to
+ * multiply by x^(8 * n), which we get by repeated squaring.  This
+ * way holes of any size cost a few hundred shifts.
+ */
+u_int32_t crc_zeros(u_int32_t crc, off_t n)
+{
+	u_int32_t power;
+
+	for (power = 1 << 8; n > 0; n >>= 1)
+	{
+		if (n & 1)
+			crc = crc_multiply(crc, power);
+		power = crc_multiply(power, power);
+	}
+
+	return crc;
+} /* crc_zeros */
+
+/*
+ * Returns what `crc1' becomes after the `len2' bytes whose CRC,
+ * started at ~0 like every other, is `crc2'.  The CRC is linear:
+ * the bytes and the initial value contribute separately, so we only
+ * need to trade the ~0 `crc2' started from for `crc1', which is
+ * shifted through the bytes by crc_zeros().  This way the pieces of
+ * a stream can be checksummed apart, in any order, and put together
+ * in O(log len2).
+ */
+u_int32_t crc_combine(u_int32_t crc1, u_int32_t crc2, off_t len2)
+{
+	return crc_zeros(crc1 ^ ~0, len2) ^ crc2;
+} /* crc_combine */
+
+/* Returns `crc' updated with the `len' bytes at `buf'. */
+u_int32_t crc_buffer(u_int32_t crc, void const *buf, size_t len)
+{
+#ifdef CONFIG_CRC_CLMUL
+	/* Below a few cache lines setting up the registers
+	 * doesn't pay off. */
+	if (crc_has_clmul && len >= 256)
+		return crc_clmul(crc, buf, len);
+#endif
+	return crc_slice16(crc, buf, len);
+} /* crc_buffer */
+
+/* Private functions */
+/*
+ * Slice-by-16: the CRC of 16 bytes is the sum of what each of them
+ * contributes with as many zeros after it as there are bytes behind
+ * it in the slice, which is what crc_slices[] has.  The old CRC adds
+ * to the first four bytes.
+ */
+u_int32_t crc_slice16(u_int32_t crc, u_int8_t const *p, size_t len)
+{
+	for (; len >= 16; p += 16, len -= 16)
+	{
+		u_int32_t w;
+
+		w = crc ^ (((u_int32_t)p[0] << 24) | ((u_int32_t)p[1] << 16)
+			| ((u_int32_t)p[2] << 8) | p[3]);
+		crc = crc_slices[15][w >> 24]
+			^ crc_slices[14][(w >> 16) & 0xFF]
+			^ crc_slices[13][(w >> 8) & 0xFF]
+			^ crc_slices[12][w & 0xFF]
+			^ crc_slices[11][p[4]] ^ crc_slices[10][p[5]]
+			^ crc_slices[9][p[6]] ^ crc_slices[8][p[7]]
+			^ crc_slices[7][p[8]] ^ crc_slices[6][p[9]]
+			^ crc_slices[5][p[10]] ^ crc_slices[4][p[11]]
+			^ crc_slices[3][p[12]] ^ crc_slices[2][p[13]]
+			^ crc_slices[1][p[14]] ^ crc_slices[0][p[15]];
+	}
+
+	for (; len > 0; len--, p++)
+		updateCRC(crc, *p);
+
+	return crc;
+} /* crc_slice16 */
+
+#ifdef CONFIG_CRC_CLMUL
+/*
+ * Folds the input into 128-bit registers: for a register X of the
+ * high and low halves H and L, X * x^n = H * x^(n + 64) + L * x^n,
+ * and the constants for those powers are short enough for the product
+ * to fit in 128 bits again.  Four registers are folded 64 bytes ahead
+ * to keep the multiplier busy, then into one.  The remaining register
+ * is the message whose CRC from zero is the one we want.
+ */
+u_int32_t crc_clmul(u_int32_t crc, u_int8_t const *p, size_t len)
+{
+	unsigned i;
+	u_int8_t last[16];
+	__m128i swap, fold1, fold4, x[4];
+
+	/* Byte-swapped, bit n of the registers is x^n. */
+	swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+		8, 9, 10, 11, 12, 13, 14, 15);
+	fold1 = _mm_set_epi64x(crc_fold1[1], crc_fold1[0]);
+	fold4 = _mm_set_epi64x(crc_fold4[1], crc_fold4[0]);
+
+	for (i = 0; i < MEMBS_OF(x); i++)
+		x[i] = _mm_shuffle_epi8(
+			_mm_loadu_si128((__m128i const *)&p[16 * i]), swap);
+	x[0] = _mm_xor_si128(x[0], _mm_set_epi32(crc, 0, 0, 0));
+	p += 64;
+	len -= 64;
+
+	for (; len >= 64; p += 64, len -= 64)
+		for (i = 0; i < MEMBS_OF(x); i++)
+			x[i] = _mm_xor_si128(_mm_xor_si128(
+				_mm_clmulepi64_si128(x[i], fold4, 0x11),
+				_mm_clmulepi64_si128(x[i], fold4, 0x00)),
+				_mm_shuffle_epi8(_mm_loadu_si128(
+					(__m128i const *)&p[16 * i]), swap));
+
+	for (i = 1; i < MEMBS_OF(x); i++)
+		x[0] = _mm_xor_si128(_mm_xor_si128(
+			_mm_clmulepi64_si128(x[0], fold1, 0x11),
+			_mm_clmulepi64_si128(x[0], fold1, 0x00)), x[i]);
+	for (; len >= 16; p += 16, len -= 16)
+		x[0] = _mm_xor_si128(_mm_xor_si128(
+			_mm_clmulepi64_si128(x[0], fold1, 0x11),
+			_mm_clmulepi64_si128(x[0], fold1, 0x00)),
+			_mm_shuffle_epi8(
+				_mm_loadu_si128((__m128i const *)p), swap));
+
+	_mm_storeu_si128((__m128i *)last, _mm_shuffle_epi8(x[0], swap));
+	crc = crc_slice16(0, last, sizeof(last));
+	return crc_slice16(crc, p, len);
+} /* crc_clmul */
+#endif /* CONFIG_CRC_CLMUL */
+
+/* Returns a * b modulo the polynomial, most significant bit first.
+ * crc32Table[1] is x^32 modulo the polynomial, that is, its low
+ * 32 bits. */
+u_int32_t crc_multiply(u_int32_t a, u_int32_t b)
+{
+	unsigned i;
+	u_int32_t p;
+
+	p = 0;
+	for (i = 32; i > 0; i--)
+	{
+		p = (p << 1) ^ (p & 0x80000000 ? crc32Table[1] : 0);
+		if (b & 0x80000000)
+			p ^= a;
+		b <<= 1;
+	}
+
+	return p;
+} /* crc_multiply */
+
 /* End of crc.c */
@@ -17,6 +17,12 @@
 #define updateCRC(crc, cha) \
 	((crc) = (((crc) << 8) ^ crc32Table[((crc) >> 24) ^ (cha)]))
 
+/* Function prototypes */
+extern void crc_init(void);
+extern u_int32_t crc_buffer(u_int32_t crc, void const *buf, size_t len);
+extern u_int32_t crc_zeros(u_int32_t crc, off_t n);
+extern u_int32_t crc_combine(u_int32_t crc1, u_int32_t crc2, off_t len2);
+
 /* Global variables */
 extern u_int32_t const crc32Table[];
 
@@ -14,81 +14,378 @@
 #include "main.h"
 #include "bzip.h"
 #include "bitstream.h"
+#include "crc.h"
 #include "models.h"
+#include "index.h"
+#include "member.h"
+#include "stats.h"
+#ifdef CONFIG_MULTITHREAD
+# include "threads.h"
+#endif
 #include "lc_common.h"
 
+/* Type definitions */
+/*
+ * The arrays of a block and what we know about it.  With threads
+ * a few of these are on their way through the stages: one is being
+ * decoded while the others are being inverted or written out.
+ * `error' is the exception the writer caught.  `stored' blocks
+ * have been read into `block' as they are and need no inverting.
+ * `hole' is the number of zeros to write before the block.
+ * `entry' is where the block is, for the index.  With -e `crc' is
+ * what the CRC of the `number'th block of the member should be.
+ * Only the inverse transformation uses `zptr', so the sets of a
+ * decompression share one.  `stats' is how long each stage took.
+ */
+struct blockset_st
+{
+	unsigned char *ll, *block;
+	unsigned *zptr;
+	unsigned block_end, origPtr, number;
+	u_int32_t crc;
+	off_t hole;
+	int finish, error, stored;
+	struct index_entry_st entry;
+	struct stats_st stats;
+};
+
+/*
+ * The state of a decompression: what it reads and writes, the
+ * arithmetic decoder and its models, the member being decoded and
+ * the blocksets.  The stages reach the arrays of the blockset they
+ * are working on through the thread-local pointers below.
+ */
+struct decompress_st
+{
+	struct bitstream_st *ibs, *obs;
+	int index_blocks;
+	struct stats_st *stats;
+	int block_stats;
+
+	/* The DCC95 arithmetic coder */
+	u_int32_t bigR, bigD;
+	struct models_st models;
+
+	/* The size of the blocks of this member, whether they are
+	 * followed by their CRC, and how many of them we've seen. */
+	unsigned blocksize, number;
+	int block_crcs;
+	off_t hole;
+
+	/* The CRC of the `blockLength' bytes of the block being written
+	 * out so far, and where the output window was when we last took
+	 * it.  Only the dumper stage uses them. */
+	u_int32_t blockCRC;
+	off_t blockLength;
+	u_int8_t const *crc_from;
+
+	/* The main driver machinery */
+	int may_pipeline, pipelined;
+#ifdef CONFIG_MULTITHREAD
+	unsigned *zptr;
+	struct blockset_st blocksets[3];
+	struct ring_st free_blocksets, decoded_blocksets,
+		inverted_blocksets;
+	struct worker_st inverter, dumper;
+#endif
+};
+
 /* Function prototypes */
-static void invalid_input(char const *msg)
+static void invalid_input(struct decompress_st const *dx, char const *msg)
 	__attribute__ ((noreturn));
-static unsigned read_magic(void);
-static void arithCodeStartDecoding(void);
+static unsigned read_magic(struct decompress_st *dx,
+	int *trailerp, off_t *usizep);
+static void arithCodeStartDecoding(struct decompress_st *dx);
+static void alloc_serial(unsigned blocksize);
+#ifdef CONFIG_MULTITHREAD
+static void alloc_blocksets(struct decompress_st *dx, unsigned blocksize);
+#endif
 
 /* Bitstream machinery */
-static inline unsigned bs_get_bit(void);
-static inline void bs_put_byte(u_int8_t c);
+static inline unsigned bs_get_bit(struct decompress_st *dx);
+static inline void bs_put_byte(struct decompress_st *dx, u_int8_t c);
+static inline void bs_take_crc(struct decompress_st *dx);
 
 /* The DCC95 arithmetic coder */
-static unsigned getSymbol(struct Model *m);
-static u_int32_t getUInt32(void);
+static unsigned getSymbol(struct decompress_st *dx, struct Model *m);
+static u_int32_t getUInt32(struct decompress_st *dx);
 
 /* Move-to-front decoding */
-static inline unsigned getMTFVal(unsigned symbol);
+static inline unsigned getMTFVal(struct decompress_st *dx, unsigned symbol);
 
 /* The main driver machinery */
-static int getAndMoveToFrontDecode(unsigned limit);
+static void use_blockset(struct blockset_st const *set);
+static void decode_blockset(struct decompress_st *dx,
+	struct blockset_st *set);
+static void invert_blockset(struct decompress_st const *dx,
+	struct blockset_st *set);
+static void dump_blockset(struct decompress_st *dx,
+	struct blockset_st *set);
+#ifdef CONFIG_MULTITHREAD
+static void *blockset_inverter(void *dxp);
+static void *blockset_dumper(void *dxp);
+#endif
+static int getAndMoveToFrontDecode(struct decompress_st *dx, unsigned limit);
+static void getStoredBlock(struct decompress_st *dx,
+	int finish, unsigned limit);
 static void undoReversibleTransformation(void);
 static void spotBlock(void);
-static void unRLEandDump(int finish);
+static void unRLEandDump(struct decompress_st *dx, int finish);
 
 /* Private variables */
-/* The DCC95 arithmetic coder */
-static u_int32_t bigR, bigD;
+/* The arrays of the blockset the calling thread is working on */
+static THREAD_LOCAL unsigned *zptr;
+static THREAD_LOCAL unsigned origPtr;
 
-static unsigned *zptr = NULL;
-static unsigned origPtr;
+static THREAD_LOCAL unsigned char *ll = NULL;
+static THREAD_LOCAL unsigned char *block = NULL;
+static THREAD_LOCAL unsigned block_end;
+static THREAD_LOCAL int stored;
 
-static unsigned char *ll = NULL;
-static unsigned char *block = NULL;
-static unsigned block_end;
+/*
+ * Without the pipeline a block is decoded, inverted and written out
+ * before decompress_block() returns, so all the decompressions of a
+ * thread can do with the same arrays.  Only the bigger levels make
+ * them grow; they are not cleared, as every stage writes before it
+ * reads.
+ */
+static THREAD_LOCAL struct blockset_st serial;
+static THREAD_LOCAL unsigned serial_size;
 
 /* Program code */
 /* Interface functions */
-void decompress(void)
+struct decompress_st *decompress_new(struct decompress_params_st const *params)
 {
-	int finish;
-	unsigned blocksize;
+	struct decompress_st *dx;
+
+	dx = NULL;
+	lc_recallocp(&dx, sizeof(*dx));
+	dx->ibs = params->ibs;
+	dx->obs = params->obs;
+	dx->index_blocks = params->index_blocks;
+	dx->stats = params->stats;
+	dx->block_stats = params->block_stats;
+	dx->may_pipeline = params->pipeline;
+
+	return dx;
+} /* decompress_new */
 
-	blocksize = read_magic() * 100000;
+/*
+ * Reads the magic and the header of the next member and gets ready to
+ * decode its blocks.  Returns whether the member has a trailer, which
+ * is for the caller to check.  Fills in the level of `member' and its
+ * usize if it's in the header, -1 otherwise.
+ */
+int decompress_start(struct decompress_st *dx, struct member_st *member)
+{
+	int trailer;
+
+	member->level = read_magic(dx, &trailer, &member->usize);
+	dx->blocksize = member->level * 100000;
+	dx->number = 0;
+	/* The header may lie; the input can't. */
+	if (member->usize > 0)
+		bs_preallocate(dx->obs, MIN(member->usize,
+			bs_input_left(dx->ibs) * BS_MAX_PREALLOC_RATIO));
+
+	dx->pipelined = 0;
+#ifdef CONFIG_MULTITHREAD
+	/* On a single processor the stages would just be
+	 * switching each other out of the cache. */
+	if (dx->may_pipeline)
+		dx->pipelined = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+	if (dx->pipelined)
+		alloc_blocksets(dx, dx->blocksize);
+	else
+#endif
+		alloc_serial(dx->blocksize);
 
-	lc_recallocp(&block, blocksize * sizeof(*block));
-	lc_recallocp(&ll, blocksize * sizeof(*ll));
-	lc_recallocp(&zptr, blocksize * sizeof(*zptr));
+	initBogusModel(&dx->models);
+	arithCodeStartDecoding(dx);
 
-	initBogusModel();
-	arithCodeStartDecoding();
+	return trailer;
+} /* decompress_start */
+
+/* Decodes, inverts and writes out the next block of the member, all
+ * in the calling thread.  Returns whether it was the last one. */
+int decompress_block(struct decompress_st *dx)
+{
+	alloc_serial(dx->blocksize);
+	decode_blockset(dx, &serial);
+	invert_blockset(dx, &serial);
+	dump_blockset(dx, &serial);
+
+	return serial.finish;
+} /* decompress_block */
+
+/* Checks the CRC at the end of the member. */
+void decompress_finish(struct decompress_st *dx)
+{
+	if (~getUInt32(dx) != dx->obs->crc)
+		invalid_input(dx, "CRC error");
+} /* decompress_finish */
+
+/*
+ * Decompresses the next member.  The arithmetic decoding has to be
+ * sequential, but with threads the inverse transformation is done by
+ * blockset_inverter() and the output by blockset_dumper() in the
+ * background, so we can go on decoding the next block meanwhile.
+ * Returns what decompress_start() does.
+ */
+int decompress(struct decompress_st *dx, struct member_st *member)
+{
+	int trailer;
+#ifdef CONFIG_MULTITHREAD
+	int finish;
+	unsigned i;
+	struct blockset_st *set;
+#endif
+
+	trailer = decompress_start(dx, member);
+	if (!dx->pipelined)
+	{
+		while (!decompress_block(dx))
+			;
+		decompress_finish(dx);
+		return trailer;
+	}
+
+#ifdef CONFIG_MULTITHREAD
+	ring_init(&dx->free_blocksets);
+	ring_init(&dx->decoded_blocksets);
+	ring_init(&dx->inverted_blocksets);
+	for (i = 0; i < MEMBS_OF(dx->blocksets); i++)
+		ring_push(&dx->free_blocksets, &dx->blocksets[i]);
+	worker_start(&dx->inverter, blockset_inverter, dx,
+		&dx->decoded_blocksets, &dx->inverted_blocksets);
+	worker_start(&dx->dumper, blockset_dumper, dx,
+		&dx->inverted_blocksets, &dx->free_blocksets);
 
 	do
 	{
-		finish = getAndMoveToFrontDecode(blocksize);
-		undoReversibleTransformation();
-		spotBlock();
-		unRLEandDump(finish);
+		set = ring_pop(&dx->free_blocksets);
+		assert(set != NULL);
+		if (set->error)
+			/* It has been reported already. */
+			throw_exception(set->error);
+
+		decode_blockset(dx, set);
+		finish = set->finish;
+		ring_push(&dx->decoded_blocksets, set);
 	} while (!finish);
 
-	if (~getUInt32() != output_bs.crc)
-		invalid_input("CRC error");
+	/* The output and its CRC are ours again when
+	 * all the blocksets are back. */
+	worker_join(&dx->inverter);
+	worker_join(&dx->dumper);
+	for (i = 0; i < MEMBS_OF(dx->blocksets); i++)
+	{
+		set = ring_pop(&dx->free_blocksets);
+		assert(set != NULL);
+		if (set->error)
+			throw_exception(set->error);
+	}
+
+	ring_destroy(&dx->free_blocksets);
+	ring_destroy(&dx->decoded_blocksets);
+	ring_destroy(&dx->inverted_blocksets);
+
+	decompress_finish(dx);
+#endif /* CONFIG_MULTITHREAD */
+	return trailer;
 } /* decompress */
 
+/*
+ * Tells where `dx' is in its input and the state of its decoder there,
+ * and goes back to such a place.  Like the index, this is only good
+ * between blocks and members.
+ */
+void decompress_tell(struct decompress_st const *dx,
+	struct index_entry_st *entry)
+{
+	entry->cbit = bs_tell_bit(dx->ibs);
+	entry->bigR = dx->bigR;
+	entry->bigD = dx->bigD;
+	entry->level = dx->blocksize / 100000;
+} /* decompress_tell */
+
+void decompress_seek(struct decompress_st *dx,
+	struct index_entry_st const *entry)
+{
+	bs_seek_bit(dx->ibs, entry->cbit);
+	dx->bigR = entry->bigR;
+	dx->bigD = entry->bigD;
+	dx->blocksize = entry->level * 100000;
+} /* decompress_seek */
+
+/*
+ * Writes `length' bytes of the uncompressed data from `from' on.
+ * The blocks covering the range are looked up in the index and
+ * decoded right where they are, so most of the input is not even
+ * touched.  Without the CRC at the end of the members we can't
+ * verify anything though, and the index doesn't tell whether the
+ * blocks have their own.
+ */
+void decompress_range(struct decompress_st *dx,
+	struct index_entry_st const *entries, unsigned nentries,
+	off_t from, off_t length)
+{
+	struct index_entry_st const *entry, *first, *last;
+
+	if (!length || !(first = index_lookup(entries, nentries, from)))
+		return;
+
+	initBogusModel(&dx->models);
+	dx->block_crcs = 0;
+	dx->obs->done = first->upos;
+	dx->obs->skip = from;
+	dx->obs->limit = from + length;
+
+	/* Blocks starting at or after the end of the range
+	 * are not needed. */
+	last = index_lookup(entries, nentries, from + length - 1);
+	for (entry = first; entry <= last; entry++)
+	{
+		decompress_seek(dx, entry);
+		decompress_block(dx);
+	}
+} /* decompress_range */
+
+/* Stops the stages of a decompression which failed.  The context
+ * can be used again. */
+void decompress_abort(struct decompress_st *dx)
+{
+#ifdef CONFIG_MULTITHREAD
+	worker_stop(&dx->inverter);
+	worker_stop(&dx->dumper);
+#endif
+} /* decompress_abort */
+
+void decompress_free(struct decompress_st *dx)
+{
+#ifdef CONFIG_MULTITHREAD
+	unsigned i;
+
+	for (i = 0; i < MEMBS_OF(dx->blocksets); i++)
+	{
+		lc_hugefree(&dx->blocksets[i].block);
+		lc_hugefree(&dx->blocksets[i].ll);
+	}
+	lc_hugefree(&dx->zptr);
+#endif
+	free(dx);
+} /* decompress_free */
+
 /* Private functions */
-void invalid_input(char const *msg)
+void invalid_input(struct decompress_st const *dx, char const *msg)
 {
-	logf("%s: %s", input_bs.fname, msg);
+	logf("%s: %s", dx->ibs->fname, msg);
 	throw_exception(EXIT_ERR_INPUT);
 } /* invalid_input */
 
-unsigned read_magic(void)
+unsigned read_magic(struct decompress_st *dx, int *trailerp, off_t *usizep)
 {
-	char magic[4];
+	char magic[4], version;
 	unsigned i, o;
 
 	for (i = 0; i < MEMBS_OF(magic); i++)
@@ -97,64 +394,122 @@ unsigned read_magic(void)
 		for (o = 8; o > 0; o--)
 		{
 			magic[i] <<= 1;
-			magic[i] |= bs_get_bit();
+			magic[i] |= bs_get_bit(dx);
 		}
 	}
 
+	version = magic[2];
 	if (magic[0] != 'B' || magic[1] != 'Z'
-			|| magic[2] != '0' || magic[3] < '1')
-		invalid_input("invalid magic");
+			|| (version != '0' && !INRANGE(version, MEMBER_VERSION,
+				MEMBER_VERSION_SIZED + MEMBER_VERSION_BLOCK_CRC))
+			|| magic[3] < '1')
+		invalid_input(dx, "invalid magic");
+
+	if ((dx->block_crcs = version > MEMBER_VERSION_SIZED) != 0)
+		version -= MEMBER_VERSION_BLOCK_CRC;
+	*trailerp = version != '0';
+	*usizep = version == MEMBER_VERSION_SIZED
+		? member_get_header(dx->ibs) : -1;
 	return magic[3] - '0';
 } /* read_magic */
 
-void arithCodeStartDecoding(void)
+void alloc_serial(unsigned blocksize)
+{
+	if (blocksize <= serial_size)
+		return;
+
+	lc_hugeallocp(&serial.block, blocksize * sizeof(*block), "block");
+	lc_hugeallocp(&serial.ll, blocksize * sizeof(*ll), "ll");
+	lc_hugeallocp(&serial.zptr, blocksize * sizeof(*zptr), "zptr");
+	serial_size = blocksize;
+} /* alloc_serial */
+
+#ifdef CONFIG_MULTITHREAD
+void alloc_blocksets(struct decompress_st *dx, unsigned blocksize)
+{
+	unsigned i;
+
+	lc_hugeallocp(&dx->zptr, blocksize * sizeof(*zptr), "zptr");
+	for (i = 0; i < MEMBS_OF(dx->blocksets); i++)
+	{
+		struct blockset_st *set;
+
+		set = &dx->blocksets[i];
+		lc_hugeallocp(&set->block, blocksize * sizeof(*block),
+			"block");
+		lc_hugeallocp(&set->ll, blocksize * sizeof(*ll), "ll");
+		set->zptr = dx->zptr;
+		set->error = 0;
+	}
+} /* alloc_blocksets */
+#endif /* CONFIG_MULTITHREAD */
+
+void arithCodeStartDecoding(struct decompress_st *dx)
 {
 	unsigned i;
 
-	bigR = TWO_TO_THE(smallB - 1);
-	bigD = 0;
+	dx->bigR = TWO_TO_THE(smallB - 1);
+	dx->bigD = 0;
 	for (i = 1; i <= smallB; i++)
 	{
-		bigD <<= 1;
-		bigD |= bs_get_bit();
+		dx->bigD <<= 1;
+		dx->bigD |= bs_get_bit(dx);
 	}
 } /* arithCodeStartDecoding */
 
 /*------------------------------------------------------*/
 /* Bitstream machinery					*/
 /*------------------------------------------------------*/
-unsigned bs_get_bit(void)
+unsigned bs_get_bit(struct decompress_st *dx)
 {
-	assert(INRANGE(input_bs.bit_p,
-		input_bs.bit_window, input_bs.bit_end));
+	struct bitstream_st *ibs;
+
+	ibs = dx->ibs;
+	assert(INRANGE(ibs->bit_p, ibs->bit_window, ibs->bit_end));
 
-	if (input_bs.bit_p == input_bs.bit_end)
-		bs_fill_bit(&input_bs, 0);
+	if (ibs->bit_p == ibs->bit_end)
+		bs_fill_bit(ibs, 0);
 
-	assert((*input_bs.bit_p & ~1) == 0);
-	return *input_bs.bit_p++;
+	assert((*ibs->bit_p & ~1) == 0);
+	return *ibs->bit_p++;
 } /* bs_get_bit */
 
-void bs_put_byte(u_int8_t c)
+void bs_put_byte(struct decompress_st *dx, u_int8_t c)
 {
-	assert(INRANGE(output_bs.byte_p,
-		output_bs.byte_window, output_bs.byte_end));
+	struct bitstream_st *obs;
+
+	obs = dx->obs;
+	assert(INRANGE(obs->byte_p, obs->byte_window, obs->byte_end));
 
-	if (output_bs.byte_p == output_bs.byte_end)
-		bs_flush_byte(&output_bs);
-	updateCRC(output_bs.crc, c);
-	*output_bs.byte_p++ = c;
+	if (obs->byte_p == obs->byte_end)
+	{	/* Take the CRC of the window before it's gone. */
+		bs_take_crc(dx);
+		bs_flush_byte(obs);
+		dx->crc_from = obs->byte_p;
+	}
+	*obs->byte_p++ = c;
 } /* bs_put_byte */
 
+/* Adds what's been written since `crc_from' to the block's CRC. */
+void bs_take_crc(struct decompress_st *dx)
+{
+	dx->blockCRC = crc_buffer(dx->blockCRC, dx->crc_from,
+		dx->obs->byte_p - dx->crc_from);
+	dx->blockLength += dx->obs->byte_p - dx->crc_from;
+} /* bs_take_crc */
+
 /*------------------------------------------------------*/
 /* The DCC95 arithmetic coder				*/
 /*------------------------------------------------------*/
-unsigned getSymbol(struct Model *m)
+unsigned getSymbol(struct decompress_st *dx, struct Model *m)
 {
 	unsigned symbol;
 	unsigned const *f;
+	u_int32_t bigR, bigD;
 	u_int32_t smallL, smallH, smallT, smallR, smallR_x_smallL, target;
 
+	bigR = dx->bigR;
+	bigD = dx->bigD;
 	smallT = m->totFreq;
 
 	/* Get target value */
@@ -186,8 +541,10 @@ unsigned getSymbol(struct Model *m)
 	{
 		bigR <<= 1;
 		bigD <<= 1;
-		bigD |= bs_get_bit();
+		bigD |= bs_get_bit(dx);
 	}
+	dx->bigR = bigR;
+	dx->bigD = bigD;
 
 	symbol = f - m->freq;
 	assert(INRANGE(symbol, 0, m->numSymbols - 1));
@@ -196,36 +553,245 @@ unsigned getSymbol(struct Model *m)
 	return symbol;
 } /* getSymbol */
 
-u_int32_t getUInt32(void)
+u_int32_t getUInt32(struct decompress_st *dx)
 {
-	return (getSymbol(&model_bogus) << 24)
-		| (getSymbol(&model_bogus) << 16)
-		| (getSymbol(&model_bogus) << 8)
-		| getSymbol(&model_bogus);
+	return (getSymbol(dx, &dx->models.bogus) << 24)
+		| (getSymbol(dx, &dx->models.bogus) << 16)
+		| (getSymbol(dx, &dx->models.bogus) << 8)
+		| getSymbol(dx, &dx->models.bogus);
 } /* getUInt32 */
 
 /*------------------------------------------------------*/
 /* Move-to-front encoding/decoding			*/
 /*------------------------------------------------------*/
-unsigned getMTFVal(unsigned symbol)
+unsigned getMTFVal(struct decompress_st *dx, unsigned symbol)
 {
 	return symbol == VAL_ONE
 		? 1
-		: (getSymbol(MTFVals_decode[symbol].m)
+		: (getSymbol(dx,
+				&dx->models.m[MTFVals_decode[symbol].model])
 			| MTFVals_decode[symbol].n);
 } /* getMFTVal */
 
 /*------------------------------------------------------*/
 /* The main driver machinery 				*/
 /*------------------------------------------------------*/
-int getAndMoveToFrontDecode(unsigned limit)
+/* Points the stages run by the calling thread at `set'. */
+void use_blockset(struct blockset_st const *set)
+{
+	ll = set->ll;
+	block = set->block;
+	zptr = set->zptr;
+	block_end = set->block_end;
+	origPtr = set->origPtr;
+	stored = set->stored;
+} /* use_blockset */
+
+/* Reads the next block of the member into `set'. */
+void decode_blockset(struct decompress_st *dx, struct blockset_st *set)
+{
+	double start, read;
+	struct perf_st perf;
+
+	start = read = 0;
+	if (dx->stats)
+	{
+		start = stats_now();
+		read = dx->ibs->secs;
+		perf_start(&perf);
+	}
+
+	set->entry.cbit = bs_tell_bit(dx->ibs);
+	set->entry.bigR = dx->bigR;
+	set->entry.bigD = dx->bigD;
+	set->entry.level = dx->blocksize / 100000;
+
+	use_blockset(set);
+	set->finish = getAndMoveToFrontDecode(dx, dx->blocksize);
+	set->block_end = block_end;
+	set->origPtr = origPtr;
+	set->stored = stored;
+	set->hole = dx->hole;
+	if (dx->block_crcs)
+		set->crc = ~getUInt32(dx);
+	set->number = ++dx->number;
+
+	memset(&set->stats, 0, sizeof(set->stats));
+	if (dx->stats)
+	{	/* The time the decoder waited for input is not its own. */
+		read = dx->ibs->secs - read;
+		set->stats.secs[STATS_DECODE] = stats_now() - start - read;
+		set->stats.secs[STATS_READ] = read;
+		set->stats.in = (bs_tell_bit(dx->ibs) - set->entry.cbit)
+			/ BITS_OF(u_int8_t);
+		perf_stop(&perf, set->stats.counts[STATS_DECODE]);
+	}
+} /* decode_blockset */
+
+void invert_blockset(struct decompress_st const *dx,
+	struct blockset_st *set)
+{
+	double start;
+	struct perf_st perf;
+
+	start = 0;
+	if (dx->stats)
+	{
+		start = stats_now();
+		perf_start(&perf);
+	}
+	use_blockset(set);
+	if (!stored)
+	{
+		undoReversibleTransformation();
+		spotBlock();
+	}
+
+	if (dx->stats)
+	{
+		perf_stop(&perf, set->stats.counts[STATS_INVERT]);
+		set->stats.secs[STATS_INVERT] = stats_now() - start;
+	}
+} /* invert_blockset */
+
+void dump_blockset(struct decompress_st *dx, struct blockset_st *set)
+{
+	struct bitstream_st *obs;
+	double start, written;
+	struct perf_st perf;
+
+	obs = dx->obs;
+	start = written = 0;
+	if (dx->stats)
+	{
+		start = stats_now();
+		written = obs->secs;
+		perf_start(&perf);
+	}
+
+	use_blockset(set);
+	if (dx->index_blocks)
+	{
+		set->entry.upos = obs->done
+			+ (obs->byte_p - obs->byte_window);
+		index_add(&set->entry);
+	}
+
+	if (set->hole)
+	{
+		obs->crc = crc_zeros(obs->crc, set->hole);
+		bs_put_zeros(obs, set->hole);
+	}
+	unRLEandDump(dx, set->finish);
+	if (dx->block_crcs && dx->blockCRC != set->crc)
+	{
+		logf("%s: block %u: CRC error", dx->ibs->fname, set->number);
+		throw_exception(EXIT_ERR_INPUT);
+	}
+	obs->crc = crc_combine(obs->crc, dx->blockCRC, dx->blockLength);
+
+	if (dx->stats)
+	{	/* The dumper is the last stage, with threads too. */
+		struct stats_st *stats;
+
+		stats = &set->stats;
+		perf_stop(&perf, stats->counts[STATS_DUMP]);
+		written = obs->secs - written;
+		stats->secs[STATS_DUMP] = stats_now() - start - written;
+		stats->secs[STATS_WRITE] = written;
+		stats->out = set->hole + dx->blockLength;
+		stats->blocks = 1;
+		stats_add(dx->stats, stats);
+		if (dx->block_stats)
+			stats_report(dx->ibs->fname, dx->stats->blocks,
+				stats, 0);
+	}
+} /* dump_blockset */
+
+#ifdef CONFIG_MULTITHREAD
+void *blockset_inverter(void *dxp)
+{
+	int finish;
+	struct blockset_st *set;
+	struct decompress_st *dx;
+
+	/* `set' is not ours anymore after we've passed it on. */
+	dx = dxp;
+	do
+	{
+		if (!(set = ring_pop(&dx->decoded_blocksets)))
+			break;
+		finish = set->finish;
+		invert_blockset(dx, set);
+		ring_push(&dx->inverted_blocksets, set);
+	} while (!finish);
+
+	return NULL;
+} /* blockset_inverter */
+
+/*
+ * Writes out the inverted blocksets and gives them back to the main
+ * thread.  After an error the rest of them are only marked failed,
+ * so the main thread learns about it sooner or later.
+ */
+void *blockset_dumper(void *dxp)
+{
+	jmp_buf handler;
+	int volatile error, finish;
+	struct blockset_st *volatile set;
+	struct decompress_st *dx;
+
+	dx = dxp;
+	set = NULL;
+	finish = 0;
+	if ((error = setjmp(handler)) != 0)
+	{
+		set->error = error;
+		ring_push(&dx->free_blocksets, set);
+	}
+	catch_exceptions(&handler);
+
+	while (!finish
+		&& (set = ring_pop(&dx->inverted_blocksets)) != NULL)
+	{
+		finish = set->finish;
+		if (!error)
+			dump_blockset(dx, set);
+		set->error = error;
+		ring_push(&dx->free_blocksets, set);
+	}
+
+	return NULL;
+} /* blockset_dumper */
+#endif /* CONFIG_MULTITHREAD */
+
+int getAndMoveToFrontDecode(struct decompress_st *dx, unsigned limit)
 {
 	char yy[256];
 	int32_t i, tmpOrigPtr;
 
-	tmpOrigPtr = getUInt32();
+	dx->hole = 0;
+	tmpOrigPtr = getUInt32(dx);
+	if ((u_int32_t)tmpOrigPtr == HOLE_BLOCK)
+	{
+		u_int32_t high;
+
+		if ((high = getUInt32(dx)) >= 0x80000000)
+			invalid_input(dx, "file corrupt");
+		dx->hole = ((off_t)high << 32) | getUInt32(dx);
+		if (!dx->hole || (u_int32_t)(tmpOrigPtr = getUInt32(dx))
+				== HOLE_BLOCK)
+			invalid_input(dx, "file corrupt");
+	}
+
+	if ((stored = tmpOrigPtr == STORED_BLOCK
+		|| (u_int32_t)tmpOrigPtr == STORED_LAST_BLOCK))
+	{
+		getStoredBlock(dx, tmpOrigPtr != STORED_BLOCK, limit);
+		return tmpOrigPtr != STORED_BLOCK;
+	}
 	origPtr = (tmpOrigPtr < 0 ? -tmpOrigPtr : tmpOrigPtr) - 1;
-	initModels();
+	initModels(&dx->models);
 
 	for (i = 0; i < 256; i++)
 		yy[i] = i;
@@ -234,7 +800,7 @@ int getAndMoveToFrontDecode(unsigned limit)
 	{
 		unsigned nextSym;
 
-		nextSym = getSymbol(&models[MODEL_BASIS]);
+		nextSym = getSymbol(dx, &dx->models.m[MODEL_BASIS]);
 		if (nextSym == VAL_RUNA || nextSym == VAL_RUNB)
 		{ /* Acquire run-length bits, most significant first */
 			unsigned n;
@@ -246,11 +812,12 @@ int getAndMoveToFrontDecode(unsigned limit)
 				n++;
 				if (nextSym == VAL_RUNA)
 					n++;
-				nextSym = getSymbol(&models[MODEL_BASIS]);
+				nextSym = getSymbol(dx,
+					&dx->models.m[MODEL_BASIS]);
 			} while (nextSym == VAL_RUNA || nextSym == VAL_RUNB);
 
 			if (block_end + n > limit)
-				invalid_input("file corrupt");
+				invalid_input(dx, "file corrupt");
 
 			memset(&ll[block_end], yy[0], n);
 			block_end += n;
@@ -258,19 +825,39 @@ int getAndMoveToFrontDecode(unsigned limit)
 
 		if (nextSym == VAL_EOB)
 			break;
-		nextSym = getMTFVal(nextSym);
+		nextSym = getMTFVal(dx, nextSym);
 		assert(INRANGE(nextSym, 1, 255));
 
 		if (block_end >= limit)
-			invalid_input("file corrupt");
+			invalid_input(dx, "file corrupt");
 		ll[block_end] = yy[nextSym];
 		memmove(&yy[1], &yy[0], nextSym);
 		yy[0] = ll[block_end];
 	} /* for */
 
+	/* The inverse BWT would start outside the block. */
+	if (origPtr >= block_end)
+		invalid_input(dx, "file corrupt");
+
 	return tmpOrigPtr < 0;
 } /* getAndMoveToFrontDecode */
 
+/* Reads a block which sendStoredBlock() sent as it is, then
+ * resumes the arithmetic decoding. */
+void getStoredBlock(struct decompress_st *dx, int finish, unsigned limit)
+{
+	u_int8_t buf[4];
+
+	bs_align(dx->ibs);
+	bs_get_bytes(dx->ibs, buf, sizeof(buf));
+	block_end = lc_get_be(buf, sizeof(buf));
+	if (block_end > limit || (finish && !block_end))
+		invalid_input(dx, "file corrupt");
+
+	bs_get_bytes(dx->ibs, block, block_end);
+	arithCodeStartDecoding(dx);
+} /* getStoredBlock */
+
 /*
  * Use: ll[0 .. last] and origPtr
  * Def: block[0 .. last]
@@ -318,7 +905,7 @@ void spotBlock(void)
 	}
 } /* spotBlock */
 
-void unRLEandDump(int finish)
+void unRLEandDump(struct decompress_st *dx, int finish)
 {
 	int chPrev;
 	unsigned i, count;
@@ -326,6 +913,12 @@ void unRLEandDump(int finish)
 	if (finish)
 		block_end--;
 
+	/* bs_put_byte() takes the CRC of what we've written when the
+	 * window is full, we do the rest.  It's only the block's,
+	 * the caller adds it to the stream's. */
+	dx->blockCRC = ~0;
+	dx->blockLength = 0;
+	dx->crc_from = dx->obs->byte_p;
 	count = 0;
 	chPrev = -1;
 	for (i = 0; i < block_end; i++)
@@ -333,7 +926,7 @@ void unRLEandDump(int finish)
 		int ch;
 
 		ch = block[i];
-		bs_put_byte(ch);
+		bs_put_byte(dx, ch);
 
 		if (ch != chPrev)
 		{
@@ -348,14 +941,15 @@ void unRLEandDump(int finish)
 
 		i++;
 		if (i >= block_end)
-			invalid_input("file corrupt");
+			invalid_input(dx, "file corrupt");
 
 		for (count = block[i]; count > 0; count--)
-			bs_put_byte(ch);
+			bs_put_byte(dx, ch);
 	} /* for */
 
+	bs_take_crc(dx);
 	if (finish && block[i] != 42)
-		invalid_input("file corrupt");
+		invalid_input(dx, "file corrupt");
 } /* unRLEandDump */
 
 /* End of decompress.c */
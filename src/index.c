@@ -0,0 +1,201 @@
+/*
+ * index.c -- block index of compressed files
+ *
+ * The index is a sidecar file made while decompressing with -i.
+ * It begins with INDEX_MAGIC, followed by one record per block:
+ *
+ *	cbit	8 bytes	bit offset of the block in the compressed file
+ *	upos	8 bytes	offset of its first byte in the uncompressed data
+ *	bigR	4 bytes	the state of the arithmetic decoder
+ *	bigD	4 bytes	at the beginning of the block
+ *	level	1 byte	block size of the member the block is in
+ *
+ * All numbers are big-endian.  The compressed file itself is left
+ * alone, so it can still be read by any decoder.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "main.h"
+#include "index.h"
+#include "lc_common.h"
+
+/* Standard definitions */
+#define INDEX_MAGIC			"BZI0"
+#define INDEX_RECORD_SIZE		(8 + 8 + 4 + 4 + 1)
+
+/* Function prototypes */
+static void invalid_index(char const *fname, char const *msg)
+	__attribute__ ((noreturn));
+
+/* Private variables */
+static FILE *index_fp;
+static char const *index_fname;
+
+/* Program code */
+/* Interface functions */
+void index_create(char const *fname)
+{
+	if (!(index_fp = fopen(fname, "w")))
+	{
+		logf("open: %s: %s", fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+
+	index_fname = fname;
+	if (fwrite(STR_LEN(INDEX_MAGIC), 1, index_fp) != 1)
+	{
+		logf("write: %s: %s", fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+} /* index_create */
+
+/* Appends `entry' to the index being created.  Blocks must be
+ * added in the order they are in the uncompressed data. */
+void index_add(struct index_entry_st const *entry)
+{
+	u_int8_t rec[INDEX_RECORD_SIZE];
+
+	lc_put_be(&rec[0], entry->cbit, 8);
+	lc_put_be(&rec[8], entry->upos, 8);
+	lc_put_be(&rec[16], entry->bigR, 4);
+	lc_put_be(&rec[20], entry->bigD, 4);
+	lc_put_be(&rec[24], entry->level, 1);
+
+	if (fwrite(rec, sizeof(rec), 1, index_fp) != 1)
+	{
+		logf("write: %s: %s", index_fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+} /* index_add */
+
+void index_finish(void)
+{
+	int failed;
+
+	failed = fclose(index_fp) != 0;
+	index_fp = NULL;
+	if (failed)
+	{
+		logf("close: %s: %s", index_fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+} /* index_finish */
+
+/* Returns the entries of the index `fname' and their number
+ * in *nentriesp.  The caller should free() them. */
+struct index_entry_st *index_load(char const *fname, unsigned *nentriesp)
+{
+	FILE *fp;
+	unsigned n, size;
+	u_int8_t rec[INDEX_RECORD_SIZE];
+	struct index_entry_st *entries;
+
+	if (!(fp = fopen(fname, "r")))
+	{
+		logf("open: %s: %s", fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+
+	if (fread(rec, STRLEN(INDEX_MAGIC), 1, fp) != 1
+			|| memcmp(rec, STR_LEN(INDEX_MAGIC)))
+	{
+		fclose(fp);
+		invalid_index(fname, "invalid magic");
+	}
+
+	n = size = 0;
+	entries = NULL;
+	while (fread(rec, sizeof(rec), 1, fp) == 1)
+	{
+		struct index_entry_st *entry;
+
+		if (n == size)
+		{
+			size = size ? size * 2 : 64;
+			if (!(entry = realloc(entries,
+				size * sizeof(*entries))))
+			{
+				logf("realloc: %s", strerror(errno));
+				free(entries);
+				fclose(fp);
+				throw_exception(EXIT_ERR_OTHER);
+			}
+			entries = entry;
+		}
+
+		entry = &entries[n++];
+		entry->cbit = lc_get_be(&rec[0], 8);
+		entry->upos = lc_get_be(&rec[8], 8);
+		entry->bigR = lc_get_be(&rec[16], 4);
+		entry->bigD = lc_get_be(&rec[20], 4);
+		entry->level = lc_get_be(&rec[24], 1);
+
+		if (!entry->level || entry->cbit < 0
+			|| entry->upos < 0
+			|| (n > 1 && (entry->cbit <= entry[-1].cbit
+				|| entry->upos < entry[-1].upos)))
+		{
+			free(entries);
+			fclose(fp);
+			invalid_index(fname, "corrupt index");
+		}
+	} /* while */
+
+	if (ferror(fp))
+	{
+		logf("read: %s: %s", fname, strerror(errno));
+		free(entries);
+		fclose(fp);
+		throw_exception(EXIT_ERR_OTHER);
+	}
+	fclose(fp);
+
+	*nentriesp = n;
+	return entries;
+} /* index_load */
+
+/* Returns the last entry starting at or before `upos',
+ * or NULL if there is none. */
+struct index_entry_st const *index_lookup(
+	struct index_entry_st const *entries, unsigned nentries, off_t upos)
+{
+	unsigned lo, hi;
+
+	if (!nentries || entries[0].upos > upos)
+		return NULL;
+
+	/* entries[lo].upos <= upos < entries[hi].upos */
+	lo = 0;
+	hi = nentries;
+	while (hi - lo > 1)
+	{
+		unsigned mid;
+
+		mid = lo + (hi - lo) / 2;
+		if (entries[mid].upos <= upos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	/* Of the blocks starting at the same place
+	 * all but the last one are empty. */
+	return &entries[lo];
+} /* index_lookup */
+
+/* Private functions */
+void invalid_index(char const *fname, char const *msg)
+{
+	logf("%s: %s", fname, msg);
+	throw_exception(EXIT_ERR_INPUT);
+} /* invalid_index */
+
+/* End of index.c */
@@ -0,0 +1,34 @@
+/* index.h */
+#ifndef INDEX_H
+#define INDEX_H
+
+/* Include files */
+#include "config.h"
+
+#include <sys/types.h>
+
+/* Type definitions */
+/*
+ * Where a block starts in the compressed file and in the uncompressed
+ * data, and the state of the arithmetic decoder there.  The models
+ * are reinitialized at every block and the bogus one is static, so
+ * this is all it takes to start decoding in the middle of a file.
+ */
+struct index_entry_st
+{
+	off_t cbit, upos;
+	u_int32_t bigR, bigD;
+	unsigned level;
+};
+
+/* Function prototypes */
+extern void index_create(char const *fname);
+extern void index_add(struct index_entry_st const *entry);
+extern void index_finish(void);
+
+extern struct index_entry_st *index_load(char const *fname,
+	unsigned *nentriesp);
+extern struct index_entry_st const *index_lookup(
+	struct index_entry_st const *entries, unsigned nentries, off_t upos);
+
+#endif /* ! INDEX_H */
@@ -19,17 +19,92 @@
 #include <fcntl.h>
 
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+# include <signal.h>
+#endif
 
 #include "main.h"
 #ifdef CONFIG_FANCY_UI
 # include "cmdline.h"
 #endif
 #include "bitstream.h"
+#include "member.h"
+#include "stats.h"
+#ifdef CONFIG_DECOMPRESS
+# include "index.h"
+#endif
+#ifdef CONFIG_MULTITHREAD
+# include "threads.h"
+#endif
 #include "lc_common.h"
 
 /* Standard definitions */
 #define DFLT_COMPRESSION_LEVEL		9
 
+/* Number of byte windows of threaded bitstreams */
+#define BS_NWINDOWS			4
+
+/* lc_hugeallocp() */
+#define HUGE_PAGE_SIZE			(2 * 1024 * 1024)
+
+enum
+{
+	HUGEALLOC_HEAP,
+	HUGEALLOC_HUGETLB,
+	HUGEALLOC_THP
+};
+
+/* Type definitions */
+/*
+ * Book-keeping of the mappings of lc_hugeallocp(), which have to be
+ * released with munmap() and their exact length.  It's kept apart
+ * from the arrays: writing it in front of one would fault in a whole
+ * huge page of an array which may never be used.  Arrays on the heap
+ * are not listed.
+ */
+struct hugealloc_st
+{
+	void *ptr;
+	size_t size;
+	int how;
+	struct hugealloc_st *next;
+};
+
+#ifdef CONFIG_MULTITHREAD
+/*
+ * A thread doing the read()s or the write()s of a bitstream while
+ * the main thread is busy with the data.  The windows circulate
+ * between them through `full' and `free'; `handed' is the one the
+ * main thread is working with.  Failures are reported in the
+ * windows' `err', then the reader stops and the writer drops the
+ * rest of the output.
+ */
+struct bs_window_st
+{
+	u_int8_t *buf;
+	size_t len;
+	off_t hole;
+	int err;
+};
+
+struct bs_thread_st
+{
+	struct worker_st worker;
+	struct ring_st full, free;
+	struct bs_window_st windows[BS_NWINDOWS], *handed;
+
+	struct bitstream_st *bs;
+	int output, eof, failed;
+};
+#endif /* CONFIG_MULTITHREAD */
+
+#ifndef CONFIG_MULTITHREAD
+# define CANCELLABLE(call)	(call)
+#endif
+
 /* Function prototypes */
 static void die(int exitcode, char const *fmt, ...)
 	__attribute__ ((format (printf, 2, 3)))
@@ -37,38 +112,106 @@ static void die(int exitcode, char const *fmt, ...)
 static void unexpected_eof(struct bitstream_st const *bs)
 	__attribute__ ((noreturn));
 
+static void hugealloc_link(struct hugealloc_st *ha);
+static struct hugealloc_st *hugealloc_unlink(void const *ptr);
+static void hugealloc_free(struct hugealloc_st *ha);
+static struct hugealloc_st *hugealloc_map(size_t size);
+
 static unsigned lc_atou(char const *str, unsigned base);
+static void parse_range(char const *str);
 static int issymlink(int fd, char const *fname);
 static char const *makeup_output_fname(struct bitstream_st const *ibs);
 static mode_t makeup_output_perms(struct bitstream_st const *bs);
 
 static void bs_open_input(struct bitstream_st *bs, char const *fname);
+static void bs_setup_input(struct bitstream_st *bs);
+static void bs_map_input(struct bitstream_st *bs);
+#ifdef HAVE_MMAP
+static void bs_sigbus(int sig, siginfo_t *info, void *context);
+static void bs_catch_sigbus(struct bitstream_st const *bs);
+#endif
+static void bs_check_map(struct bitstream_st const *bs);
+static void bs_find_hole(struct bitstream_st *bs, off_t pos);
 static void bs_open_output(struct bitstream_st *obs, char const *fname);
+static void bs_open_nowhere(struct bitstream_st *bs);
+static void bs_setup_output(struct bitstream_st *bs);
+static void bs_alloc_window(struct bitstream_st *bs, int output);
 
 static unsigned bs_read(struct bitstream_st const *bs,
 	void *data, size_t size);
+static unsigned bs_read_window(struct bitstream_st *bs, int eofok);
+static void bs_write_window(struct bitstream_st *bs);
+static void bs_zero_window(struct bitstream_st *bs, size_t size);
+static void bs_grow_window(struct bitstream_st *bs, size_t keep,
+	size_t room);
+static int bs_extend(int fd, off_t size);
 static void bs_write(struct bitstream_st *bs,
 	void const *data, size_t size);
+#ifdef CONFIG_IO_URING
+static unsigned bs_read_ahead(struct bitstream_st *bs);
+static void bs_write_behind(struct bitstream_st *bs, size_t size);
+#endif
+#ifdef CONFIG_MULTITHREAD
+static void bs_start_thread(struct bitstream_st *bs, int output);
+static int bs_stop_thread(struct bitstream_st *bs);
+static unsigned bs_thread_read(struct bitstream_st *bs);
+static void bs_thread_write(struct bitstream_st *bs, size_t size);
+static void *bs_reader(void *threadp);
+static void *bs_writer(void *threadp);
+#endif
 
 static void bs_crc_init(struct bitstream_st *bs);
-static void bs_align(struct bitstream_st *bs);
 static int bs_eof(struct bitstream_st *bs);
 static void bs_rewind(struct bitstream_st *bs);
 
 static void bs_close(struct bitstream_st *bs);
 static void bs_close_input(struct bitstream_st *bs);
 static void bs_close_output(struct bitstream_st *bs);
+static void bs_open_memory(struct bitstream_st *bs,
+	void const *buf, size_t size, int output);
 
+static off_t bzip_member(struct compress_st *cx, int trailer,
+	struct bitstream_st *ibs, struct bitstream_st *obs);
 static void bzip(struct bitstream_st *ibs, struct bitstream_st *obs);
+static void bunzip_member(struct decompress_st *dx,
+	struct bitstream_st *ibs, struct bitstream_st *obs,
+	struct member_st *member);
+static void print_member(char const *what, struct member_st const *member);
+static void list_members(struct decompress_st *dx,
+	struct bitstream_st *ibs, struct bitstream_st *obs);
 static void bunzip(struct bitstream_st *ibs, struct bitstream_st *obs);
+static int verify_input(char const *fname);
+static int verify_inputs(char const *const *inputs);
 static void parse_cmdline(int argc, char *argv[]);
 #ifndef HAVE_BASENAME
 static char const *basename(char const *fname);
 #endif
 
 /* Private variables */
-static char const *bzip_prgname;
+/* For logf(), until main() knows better */
+static char const *bzip_prgname = "bzip";
 static jmp_buf exception_handler;
+/* Where the exceptions of worker threads and of the callers
+ * of bzip_buffer() and bunzip_buffer() go */
+static THREAD_LOCAL jmp_buf *thread_exception_handler;
+#ifdef CONFIG_MULTITHREAD
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+#endif
+/* The mappings of lc_hugeallocp(), which the threads share */
+static struct hugealloc_st *hugeallocs;
+#ifdef CONFIG_MULTITHREAD
+static pthread_mutex_t hugealloc_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+/* What the stages took on the file being processed, with -v */
+static struct stats_st file_stats;
+#ifdef HAVE_MMAP
+/* The input mapped by bs_map_input(), and whether it was found
+ * truncated under us, for bs_sigbus() */
+static u_int8_t *volatile sigbus_map;
+static size_t volatile sigbus_map_size;
+static volatile sig_atomic_t sigbus_truncated;
+static size_t sigbus_pagesize;
+#endif
 
 /* Global variable definifions */
 struct main_runtime_st main_runtime;
@@ -101,9 +244,23 @@ void panic(char const *fmt, ...)
 
 void throw_exception(int errorcode)
 {
+	if (thread_exception_handler)
+		longjmp(*thread_exception_handler, errorcode);
 	longjmp(exception_handler, errorcode);
 } /* throw_exception */
 
+/* Makes throw_exception() longjmp() to `handler' in the calling thread
+ * rather than to main()'s handler.  Returns the previous handler,
+ * so it can be restored. */
+jmp_buf *catch_exceptions(jmp_buf *handler)
+{
+	jmp_buf *prev;
+
+	prev = thread_exception_handler;
+	thread_exception_handler = handler;
+	return prev;
+} /* catch_exceptions */
+
 void lc_recallocp(void *ptrp, size_t newsize)
 {
 	void *newptr;
@@ -118,54 +275,129 @@ void lc_recallocp(void *ptrp, size_t newsize)
 	*(void **)ptrp = newptr;
 } /* lc_reallocp */
 
-unsigned bs_fill_byte(struct bitstream_st *bs, int eofok)
+/*
+ * Like lc_recallocp(), but for the multi-megabyte arrays of the
+ * block sorter and the inverse BWT, which are accessed randomly
+ * and thus suffer a lot from TLB misses.  Tries to back them with
+ * explicit huge pages first, then with transparent huge pages,
+ * and finally falls back to the heap.  `what' is only used in
+ * the -vv report.
+ */
+void lc_hugeallocp(void *ptrp, size_t newsize, char const *what)
 {
-	unsigned n;
+	static char const *const hows[] =
+	{
+		[HUGEALLOC_HEAP]	= "heap",
+		[HUGEALLOC_HUGETLB]	= "hugetlb",
+		[HUGEALLOC_THP]		= "transparent huge pages",
+	};
 
-	assert(INRANGE(bs->byte_end,
-		bs->byte_window, AFTER_OF(bs->byte_window)));
-	assert(INRANGE(bs->byte_p, bs->byte_window, bs->byte_end));
+	struct hugealloc_st *ha;
+
+	if ((ha = hugealloc_unlink(*(void **)ptrp)) != NULL)
+	{
+		if (newsize <= ha->size)
+		{	/* Reuse the mapping. */
+			memset(ha->ptr, 0, newsize);
+			hugealloc_link(ha);
+			return;
+		}
 
-	n = bs_read(bs, bs->byte_window, sizeof(bs->byte_window));
-	bs->eof = n != sizeof(bs->byte_window);
+		hugealloc_free(ha);
+		*(void **)ptrp = NULL;
+	}
 
-	bs->byte_p = bs->byte_window;
-	bs->byte_end = &bs->byte_window[n];
+	if ((ha = hugealloc_map(newsize)) != NULL)
+	{	/* Zeroed already, and not touched until it's used. */
+		free(*(void **)ptrp);
+		*(void **)ptrp = ha->ptr;
+		hugealloc_link(ha);
+	} else
+		lc_recallocp(ptrp, newsize);
 
-	if (!n && !eofok)
-		unexpected_eof(bs);
+	/* Not among the JSON of -J, which the scripts read. */
+	if (main_runtime.verbose > 1 && !main_runtime.stats_json)
+		logf("%s: %lu bytes on %s", what, (unsigned long)newsize,
+			hows[ha ? ha->how : HUGEALLOC_HEAP]);
+} /* lc_hugeallocp */
+
+/* Releases an array of lc_hugeallocp() and clears the pointer to it. */
+void lc_hugefree(void *ptrp)
+{
+	struct hugealloc_st *ha;
+
+	if ((ha = hugealloc_unlink(*(void **)ptrp)) != NULL)
+		hugealloc_free(ha);
+	else
+		free(*(void **)ptrp);
+	*(void **)ptrp = NULL;
+} /* lc_hugefree */
+
+/* Stores the lowest `size' bytes of `n' in `buf', big-endian. */
+void lc_put_be(u_int8_t *buf, u_int64_t n, unsigned size)
+{
+	while (size-- > 0)
+	{
+		buf[size] = n & 0xFF;
+		n >>= 8;
+	}
+} /* lc_put_be */
+
+u_int64_t lc_get_be(u_int8_t const *buf, unsigned size)
+{
+	u_int64_t n;
+
+	for (n = 0; size > 0; size--)
+		n = (n << 8) | *buf++;
+	return n;
+} /* lc_get_be */
+
+unsigned bs_fill_byte(struct bitstream_st *bs, int eofok)
+{
+	unsigned n;
+	double start;
+
+	if (!bs->timed)
+		return bs_read_window(bs, eofok);
+
+	start = stats_now();
+	n = bs_read_window(bs, eofok);
+	bs->secs += stats_now() - start;
 	return n;
 } /* bs_fill_byte */
 
 void bs_flush_byte(struct bitstream_st *bs)
 {
-	u_int8_t *endp;
-
-	assert(INRANGE(bs->byte_end,
-		bs->byte_window, AFTER_OF(bs->byte_window)));
-	assert(INRANGE(bs->byte_p, bs->byte_window, bs->byte_end));
+	double start;
 
-	endp = bs->byte_p;
-	bs->byte_p = bs->byte_window;
-	if (bs->blocked)
+	if (!bs->timed)
+	{
+		bs_write_window(bs);
 		return;
+	}
 
-	bs_write(bs, bs->byte_window, endp - bs->byte_window);
+	start = stats_now();
+	bs_write_window(bs);
+	bs->secs += stats_now() - start;
 } /* bs_flush_byte */
 
 unsigned bs_fill_bit(struct bitstream_st *bs, int eofok)
 {
 #ifdef CONFIG_DECOMPRESS
-	unsigned n;
+	size_t n;
 	u_int8_t *wp;
 
 	assert(INRANGE(bs->bit_end,
 		bs->bit_window, AFTER_OF(bs->bit_window)));
 	assert(INRANGE(bs->bit_p, bs->bit_window, bs->bit_end));
 
-	n = bs->byte_end > bs->byte_p
-		? bs->byte_end - bs->byte_p
-		: bs_fill_byte(bs, eofok);
+	/* The byte window may be a mapping of the whole input,
+	 * so be careful not to overflow `n'. */
+	if (bs->byte_p == bs->byte_end)
+		bs_fill_byte(bs, eofok);
+	n = bs->byte_end - bs->byte_p;
+	if (n > BS_BIT_WINDOW)
+		n = BS_BIT_WINDOW;
 	n *= BITS_OF(u_int8_t);
 
 	bs->bit_p = bs->bit_window;
@@ -243,256 +475,1507 @@ void bs_flush_bit(struct bitstream_st *bs)
 #endif /* CONFIG_COMPRESS */
 } /* bs_flus_bit */
 
-/* Private functions */
-void die(int exitcode, char const *fmt, ...)
+/*
+ * For reading whole bytes when `bs' is at a byte boundary.  The bit
+ * window may still have a few of them; the rest is copied from the
+ * byte window.
+ */
+void bs_get_bytes(struct bitstream_st *bs, void *buf, size_t size)
 {
-	va_list printf_args;
+#ifdef CONFIG_DECOMPRESS
+	u_int8_t *p;
 
-	fprintf(stderr, "%s: ", bzip_prgname);
-	va_start(printf_args, fmt);
-	vfprintf(stderr, fmt, printf_args);
-	va_end(printf_args);
-	fputc('\n', stderr);
+	assert((bs_tell_bit(bs) % BITS_OF(u_int8_t)) == 0);
+	for (p = buf; size > 0 && bs->bit_p < bs->bit_end; size--, p++)
+	{
+		unsigned o;
 
-	exit(exitcode);
-} /* die */
+		*p = 0;
+		for (o = BITS_OF(u_int8_t); o > 0; o--)
+		{
+			*p <<= 1;
+			*p |= *bs->bit_p++;
+		}
+	}
 
-void unexpected_eof(struct bitstream_st const *bs)
+	while (size > 0)
+	{
+		size_t n;
+
+		if (bs->byte_p == bs->byte_end)
+			bs_fill_byte(bs, 0);
+		n = MIN(size, (size_t)(bs->byte_end - bs->byte_p));
+		memcpy(p, bs->byte_p, n);
+		bs->byte_p += n;
+		p += n;
+		size -= n;
+	}
+#endif /* CONFIG_DECOMPRESS */
+} /* bs_get_bytes */
+
+void bs_put_bytes(struct bitstream_st *bs, void const *buf, size_t size)
 {
-	logf("%s: unexpeced EOF", bs->fname);
-	throw_exception(EXIT_ERR_INPUT);
-} /* unexpected_eof */
+#ifdef CONFIG_COMPRESS
+	u_int8_t const *p;
 
-unsigned lc_atou(char const *str, unsigned base)
+	/* Move what's in the bit window out of the way first. */
+	assert((bs->bit_p - bs->bit_window) % BITS_OF(u_int8_t) == 0);
+	bs_flush_bit(bs);
+
+	for (p = buf; size > 0; )
+	{
+		size_t n;
+
+		if (bs->byte_p == bs->byte_end)
+			bs_flush_byte(bs);
+		n = MIN(size, (size_t)(bs->byte_end - bs->byte_p));
+		memcpy(bs->byte_p, p, n);
+		bs->byte_p += n;
+		p += n;
+		size -= n;
+	}
+#endif /* CONFIG_COMPRESS */
+} /* bs_put_bytes */
+
+/* Skips to the next byte boundary of `bs'. */
+void bs_align(struct bitstream_st *bs)
 {
-	unsigned result;
+	unsigned d;
 
-#ifdef CONFIG_FANCY_UI
-	assert(INRANGE(base, 2, 10));
+	d = (bs->bit_p - bs->bit_window) % 8;
+	if (d == 0)
+		return;
+	for (d = 8 - d; d > 0; d--)
+		*bs->bit_p++ = 0;
+} /* bs_align */
 
-	for (result = 0; *str; result *= base, result += *str++ - '0')
-		if (!INRANGE(*str, '0', '9'))
-			die(EXIT_ERR_USER, "%s: unsigned integer "
-				"expected", str);
-#endif
+/*
+ * Tells the filesystem that `size' more bytes are coming to `bs', so
+ * it can allocate them in one piece, rather than bit by bit as the
+ * windows are written.  The file size doesn't change, so we can keep
+ * appending.  It's just a hint; errors are ignored.  What isn't written
+ * in the end is given back by bs_close().
+ */
+void bs_preallocate(struct bitstream_st *bs, off_t size)
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	off_t from;
 
-	return result;
-} /* lc_atou */
+	if (bs->blocked || bs->start < 0 || bs->limit || size <= 0)
+		return;
+	from = bs->start + bs_output_size(bs);
+	if (fallocate(bs->fd, FALLOC_FL_KEEP_SIZE, from, size) == 0)
+		bs->reserved = MAX(bs->reserved, from + size);
+#endif
+} /* bs_preallocate */
 
-int issymlink(int fd, char const *fname)
+/* Returns how many bytes are left to be read from `bs' if it's
+ * a regular file or memory, 0 if we can't know. */
+off_t bs_input_left(struct bitstream_st const *bs)
 {
-#if defined(HAVE_LSTAT) && defined(CONFIG_FANCY_UI)
-	struct stat lsb, rsb;
+	off_t size;
+	struct stat sb;
 
-	if (fstat(fd, &rsb) < 0)
-	{
-		logf("fstat: %s: %s", fname, strerror(errno));
-		return 0;
-	} else if (lstat(fname, &lsb) < 0)
-	{
-		logf("lstat: %s: %s", fname, strerror(errno));
+	if (bs->map)
+		size = bs->map_size;
+	else if (bs->fd >= 0 && fstat(bs->fd, &sb) == 0
+			&& S_ISREG(sb.st_mode))
+		size = sb.st_size;
+	else
 		return 0;
-	}
 
-	return rsb.st_dev != lsb.st_dev || rsb.st_ino != lsb.st_ino;
-#else /* ! HAVE_LSTAT || ! CONFIG_FANCY_UI */
-	return 0;
-#endif
-} /* issymlink */
+	size -= bs_tell_bit(bs) / BITS_OF(u_int8_t);
+	return MAX(size, 0);
+} /* bs_input_left */
 
-char const *makeup_output_fname(struct bitstream_st const *ibs)
+/* Returns the position of the next bit to be read from `bs'. */
+off_t bs_tell_bit(struct bitstream_st const *bs)
 {
-#ifdef CONFIG_FANCY_UI
-	static char generated_fname[PATH_MAX];
+	return (bs->nread - (bs->byte_end - bs->byte_p))
+			* BITS_OF(u_int8_t)
+		- (bs->bit_end - bs->bit_p);
+} /* bs_tell_bit */
 
-	unsigned lfname, sext;
-	char const *fname, *ext;
+/*
+ * Makes the `bit'th bit of `bs' the next one to be read.  Only mapped
+ * inputs can be repositioned; pipes don't go back and we don't want
+ * to deal with the windows of the I/O threads.  Streams can go back
+ * as far as their mark.
+ */
+void bs_seek_bit(struct bitstream_st *bs, off_t bit)
+{
+	if (bs->grow)
+	{
+		off_t back;
 
-	if (ibs->stdfd)
-		return "-";
+		back = bs->nread - bit / BITS_OF(u_int8_t);
+		assert(INRANGE(back, 0, bs->byte_end - bs->byte_window));
+		bs->byte_p = bs->byte_end - back;
+		bs->bit_p = bs->bit_end = bs->bit_window;
+		if (bit % BITS_OF(u_int8_t))
+		{
+			bs_fill_bit(bs, 0);
+			bs->bit_p += bit % BITS_OF(u_int8_t);
+		}
+		return;
+	}
 
-	fname = ibs->fname;
-	lfname = strlen(fname);
-	if (IS_COMPRESS())
-	{
-		ext = ".bz";
-		sext = sizeof(".bz");
-	} else if (lfname > 3 && !memcmp(&fname[lfname - 3], ".bz", 3))
+#ifdef CONFIG_DECOMPRESS
+	if (!bs->map)
 	{
-		lfname -= 3;
-		ext = "";
-		sext = sizeof("");
-	} else
+		logf("%s: can only seek in regular files", bs->fname);
+		throw_exception(EXIT_ERR_OTHER);
+	}
+	if (!INRANGE(bit, 0, (off_t)bs->map_size * BITS_OF(u_int8_t) - 1))
 	{
-		ext = ".bunz";
-		sext = sizeof(".bunz");
+		logf("%s: seeking beyond the end of file", bs->fname);
+		throw_exception(EXIT_ERR_INPUT);
 	}
 
-	if (lfname + sext > sizeof(generated_fname))
-		lfname = sizeof(generated_fname) - sext;
-	memcpy(generated_fname, fname, lfname);
-	memcpy(&generated_fname[lfname], ext, sext);
+	bs->byte_p = &bs->map[bit / BITS_OF(u_int8_t)];
+	bs->bit_p = bs->bit_end = bs->bit_window;
+	bs_fill_bit(bs, 0);
+	bs->bit_p += bit % BITS_OF(u_int8_t);
+#endif /* CONFIG_DECOMPRESS */
+} /* bs_seek_bit */
 
-	return generated_fname;
+/*
+ * Called when the data of a sparse input runs out.  If it's a hole
+ * rather than the end of file, the window is moved past it and its
+ * size is returned, otherwise 0.  The hole is as many zeros, which
+ * is for the caller to account for.
+ */
+off_t bs_skip_hole(struct bitstream_st *bs)
+{
+#ifdef CONFIG_COMPRESS
+	off_t size;
 
-#else /* ! CONFIG_FANCY_UI */
-	return "-";
+	if (!bs->map || bs->byte_p < bs->byte_end)
+		return 0;
+
+	size = bs->hole_end - bs->byte_end;
+	if (size > 0)
+		bs_find_hole(bs, bs->hole_end - bs->map);
+	return size;
+#else /* ! CONFIG_COMPRESS */
+	return 0;
 #endif
-} /* makeup_output_fname */
+} /* bs_skip_hole */
 
-mode_t makeup_output_perms(struct bitstream_st const *bs)
+/*
+ * Appends `size' zeros to `bs'.  Regular files are just made longer,
+ * so the zeros take no disk space, and whatever is in the way of that
+ * is flushed first.  We always append, so seeking wouldn't do.
+ */
+void bs_put_zeros(struct bitstream_st *bs, off_t size)
 {
-#ifdef CONFIG_FANCY_UI
-	struct stat sb;
+#ifdef CONFIG_DECOMPRESS
+	int err;
+	off_t end;
 
-	if (main_runtime.has_perms)
-		return main_runtime.perms;
-	else if (input_bs.stdfd)
-		return 0666;
-	else if (fstat(bs->fd, &sb) < 0)
+	if (bs->blocked)
 	{
-		logf("fstat: %s: %s", bs->fname, strerror(errno));
+		bs->done += size;
+		return;
+	} else if (bs->start < 0)
+	{
+		bs_zero_window(bs, size);
+		return;
+	}
+
+	bs_flush_byte(bs);
+	end = bs->done + size;
+	if (bs->limit)
+	{	/* Only what's in [skip, limit) is written, in the window. */
+		off_t from, to;
+
+		from = MAX(bs->done, bs->skip);
+		to = MIN(end, bs->limit);
+		if (from < to)
+		{
+			bs->done = from;
+			bs_zero_window(bs, to - from);
+			bs_flush_byte(bs);
+		}
+		bs->done = end;
+		return;
+	}
+
+	bs->done = end;
+# ifdef CONFIG_MULTITHREAD
+	if (bs->thread)
+	{	/* The writer makes it before the next window. */
+		bs->thread->handed->hole += size;
+		return;
+	}
+# endif
+# ifdef CONFIG_IO_URING
+	/* The writes in flight must land before the hole. */
+	if (bs->uring && (err = uring_sync(bs->uring)) < 0)
+	{
+		logf("write: %s: %s", bs->fname, strerror(-err));
 		throw_exception(EXIT_ERR_OTHER);
-	} else
-		return sb.st_mode & 0666;
-#else /* ! CONFIG_FANCY_UI */
-	return 0;
-#endif
-} /* makeup_output_perms */
+	}
+# endif
 
-void bs_open_input(struct bitstream_st *bs, char const *fname)
+	if ((err = bs_extend(bs->fd, size)) != 0)
+	{
+		logf("ftruncate: %s: %s", bs->fname, strerror(err));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+#endif /* CONFIG_DECOMPRESS */
+} /* bs_put_zeros */
+
+/*
+ * Opens a stream, a memory bitstream whose data is given to us
+ * or taken from us a piece at a time.  The input is buffered from
+ * the mark on, so we can bs_seek_bit() back there and try again
+ * if it runs out; the size of the data is not known in advance.
+ * The output is kept until it's pulled.
+ */
+void bs_open_stream(struct bitstream_st *bs, int output)
 {
-	bs->eof = 0;
-	bs->byte_p = bs->byte_window;
-	bs->byte_end = bs->byte_window;
+	memset(bs, 0, sizeof(*bs));
+	bs->memory = bs->grow = 1;
+	bs->fd = -1;
+	bs->fname = "(stream)";
+	bs->start = bs->fpos = -1;
+
 	bs->bit_p = bs->bit_window;
-	bs->bit_end = bs->bit_window;
+	bs->bit_end = output ? AFTER_OF(bs->bit_window) : bs->bit_window;
+} /* bs_open_stream */
 
-	if (fname[0] == '-' && fname[1] == '\0')
+/* Appends `size' bytes to the input stream `bs'.  Nothing means
+ * the end of it. */
+void bs_stream_push(struct bitstream_st *bs, void const *buf, size_t size)
+{
+	if (!size)
 	{
-		bs->fd = STDIN_FILENO;
-		bs->fname = "(stdin)";
-		bs->stdfd = 1;
+		bs->eof = 1;
 		return;
 	}
 
-#ifdef CONFIG_FANCY_UI
-	if ((bs->fd = open(fname, O_RDONLY)) < 0)
-	{
-		logf("open: %s: %s", fname, strerror(errno));
-		goto out;
+	if ((size_t)(&bs->byte_buf[bs->byte_size] - bs->byte_end) < size)
+		bs_grow_window(bs, bs->byte_end - bs->byte_window, size);
+	memcpy(bs->byte_end, buf, size);
+	bs->byte_end += size;
+	bs->nread += size;
+} /* bs_stream_push */
+
+/* The input before the next bit of `bs' won't be needed anymore. */
+void bs_stream_mark(struct bitstream_st *bs)
+{
+	bs->byte_window = bs->byte_p
+		- (bs->bit_end - bs->bit_p + BITS_OF(u_int8_t) - 1)
+			/ BITS_OF(u_int8_t);
+} /* bs_stream_mark */
+
+/* Takes at most `size' bytes of the output stream `bs'.
+ * Returns how many there were. */
+size_t bs_stream_pull(struct bitstream_st *bs, void *buf, size_t size)
+{
+	size_t n;
+
+	n = MIN(size, (size_t)(bs->byte_p - bs->byte_window));
+	memcpy(buf, bs->byte_window, n);
+	bs->byte_window += n;
+	bs->done += n;
+	if (bs->byte_window == bs->byte_p)
+		bs->byte_window = bs->byte_p = bs->byte_buf;
+
+	return n;
+} /* bs_stream_pull */
+
+/*
+ * Compresses `insize' bytes at `in' into one member at `out', like -M
+ * does.  *outsizep is the size of `out' on entry, and the size of the
+ * compressed data on return.  If that's more than what `out' could
+ * hold, the output was cut short and the call should be repeated with
+ * a buffer that big.  The input is read and the output is written in
+ * place, without copying them through a window of our own.  Returns 0
+ * or the exit code of the error, which has been logged.
+ */
+int bzip_buffer(void *out, size_t *outsizep, void const *in, size_t insize,
+	unsigned level)
+{
+#ifdef CONFIG_COMPRESS
+	int volatile error;
+	jmp_buf handler, *prev;
+	struct compress_params_st params;
+	struct compress_st *volatile cx;
+	struct bitstream_st ibs, obs;
+
+	crc_init_once();
+	bs_open_memory(&ibs, in, insize, 0);
+	bs_open_memory(&obs, out, *outsizep, 1);
+
+	cx = NULL;
+	prev = catch_exceptions(&handler);
+	if ((error = setjmp(handler)) != 0)
+	{
+		if (cx)
+			compress_abort(cx);
+		goto out;
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.ibs = &ibs;
+	params.obs = &obs;
+	params.level = level;
+	params.member_trailer = 1;
+	cx = compress_new(&params);
+
+	bzip_member(cx, 1, &ibs, &obs);
+	bs_flush_bit(&obs);
+	*outsizep = bs_output_size(&obs);
+
+out:
+	catch_exceptions(prev);
+	if (cx)
+		compress_free(cx);
+	free(obs.byte_buf);
+	return error;
+#else /* ! CONFIG_COMPRESS */
+	return EXIT_ERR_OTHER;
+#endif
+} /* bzip_buffer */
+
+/*
+ * Decompresses all the members at `in' to `out', the other way around
+ * bzip_buffer() does.  *outsizep is the size of the decompressed data
+ * on return, also when it didn't fit, in which case only the CRCs are
+ * checked past the end of `out'.
+ */
+int bunzip_buffer(void *out, size_t *outsizep, void const *in, size_t insize)
+{
+#ifdef CONFIG_DECOMPRESS
+	int volatile error;
+	jmp_buf handler, *prev;
+	struct member_st member;
+	struct decompress_params_st params;
+	struct decompress_st *volatile dx;
+	struct bitstream_st ibs, obs;
+
+	crc_init_once();
+	bs_open_memory(&ibs, in, insize, 0);
+	bs_open_memory(&obs, out, *outsizep, 1);
+
+	dx = NULL;
+	prev = catch_exceptions(&handler);
+	if ((error = setjmp(handler)) != 0)
+	{
+		if (dx)
+			decompress_abort(dx);
+		goto out;
+	}
+
+	params.ibs = &ibs;
+	params.obs = &obs;
+	params.index_blocks = 0;
+	params.pipeline = 1;
+	params.stats = NULL;
+	params.block_stats = 0;
+	dx = decompress_new(&params);
+
+	do
+		bunzip_member(dx, &ibs, &obs, &member);
+	while (!bs_eof(&ibs));
+	*outsizep = bs_output_size(&obs);
+
+out:
+	catch_exceptions(prev);
+	if (dx)
+		decompress_free(dx);
+	free(obs.byte_buf);
+	return error;
+#else /* ! CONFIG_DECOMPRESS */
+	return EXIT_ERR_OTHER;
+#endif
+} /* bunzip_buffer */
+
+/* Private functions */
+void die(int exitcode, char const *fmt, ...)
+{
+	va_list printf_args;
+
+	fprintf(stderr, "%s: ", bzip_prgname);
+	va_start(printf_args, fmt);
+	vfprintf(stderr, fmt, printf_args);
+	va_end(printf_args);
+	fputc('\n', stderr);
+
+	exit(exitcode);
+} /* die */
+
+void hugealloc_link(struct hugealloc_st *ha)
+{
+#ifdef CONFIG_MULTITHREAD
+	pthread_mutex_lock(&hugealloc_lock);
+#endif
+	ha->next = hugeallocs;
+	hugeallocs = ha;
+#ifdef CONFIG_MULTITHREAD
+	pthread_mutex_unlock(&hugealloc_lock);
+#endif
+} /* hugealloc_link */
+
+/* Takes the mapping of the array at `ptr' off the list and returns it,
+ * or returns NULL if the array is on the heap. */
+struct hugealloc_st *hugealloc_unlink(void const *ptr)
+{
+	struct hugealloc_st **hap, *ha;
+
+	if (!ptr)
+		return NULL;
+
+#ifdef CONFIG_MULTITHREAD
+	pthread_mutex_lock(&hugealloc_lock);
+#endif
+	for (hap = &hugeallocs; (ha = *hap) != NULL; hap = &ha->next)
+		if (ha->ptr == ptr)
+		{
+			*hap = ha->next;
+			break;
+		}
+#ifdef CONFIG_MULTITHREAD
+	pthread_mutex_unlock(&hugealloc_lock);
+#endif
+
+	return ha;
+} /* hugealloc_unlink */
+
+void hugealloc_free(struct hugealloc_st *ha)
+{
+#ifdef HAVE_MMAP
+	munmap(ha->ptr, ha->size);
+#endif
+	free(ha);
+} /* hugealloc_free */
+
+/*
+ * Maps a fresh (and therefore zeroed) region of `size' bytes backed
+ * by huge pages.  The size is rounded up to the huge page size because
+ * that is the unit the kernel would allocate anyway.  Returns its
+ * book-keeping, not yet listed, or NULL if it can't be done.
+ */
+struct hugealloc_st *hugealloc_map(size_t size)
+{
+#ifdef HAVE_MMAP
+	int how;
+	void *ptr;
+	struct hugealloc_st *ha;
+
+	if (size < HUGE_PAGE_SIZE)
+		return NULL;
+	size = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+
+	ptr = MAP_FAILED;
+# ifdef MAP_HUGETLB
+	how = HUGEALLOC_HUGETLB;
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+# endif
+
+# if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+	if (ptr == MAP_FAILED)
+	{
+		how = HUGEALLOC_THP;
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr != MAP_FAILED
+			&& madvise(ptr, size, MADV_HUGEPAGE) < 0)
+		{	/* THP is disabled or not supported. */
+			munmap(ptr, size);
+			ptr = MAP_FAILED;
+		}
+	}
+# endif /* HAVE_MADVISE && MADV_HUGEPAGE */
+
+	if (ptr == MAP_FAILED)
+		return NULL;
+	if (!(ha = malloc(sizeof(*ha))))
+	{
+		munmap(ptr, size);
+		return NULL;
+	}
+
+	ha->ptr = ptr;
+	ha->size = size;
+	ha->how = how;
+	return ha;
+#else /* ! HAVE_MMAP */
+	return NULL;
+#endif
+} /* hugealloc_map */
+
+void unexpected_eof(struct bitstream_st const *bs)
+{
+	logf("%s: unexpeced EOF", bs->fname);
+	throw_exception(EXIT_ERR_INPUT);
+} /* unexpected_eof */
+
+unsigned lc_atou(char const *str, unsigned base)
+{
+	unsigned result;
+
+#ifdef CONFIG_FANCY_UI
+	assert(INRANGE(base, 2, 10));
+
+	for (result = 0; *str; result *= base, result += *str++ - '0')
+		if (!INRANGE(*str, '0', '9'))
+			die(EXIT_ERR_USER, "%s: unsigned integer "
+				"expected", str);
+#endif
+
+	return result;
+} /* lc_atou */
+
+/* Parses the <offset>,<length> argument of -r. */
+void parse_range(char const *str)
+{
+#ifdef CONFIG_FANCY_UI
+	char *endp;
+	unsigned long long from, len;
+
+	errno = 0;
+	from = strtoull(str, &endp, 10);
+	if (endp == str || *endp != ',')
+		die(EXIT_ERR_USER, "%s: <offset>,<length> expected", str);
+	len = strtoull(endp + 1, &endp, 10);
+	if (*endp != '\0' || !INRANGE(endp[-1], '0', '9'))
+		die(EXIT_ERR_USER, "%s: <offset>,<length> expected", str);
+	if (errno || (off_t)from < 0 || (off_t)len < 0
+			|| (off_t)(from + len) < (off_t)from)
+		die(EXIT_ERR_USER, "%s: range too large", str);
+
+	main_runtime.range_from = from;
+	main_runtime.range_len = len;
+	main_runtime.has_range = 1;
+#endif /* CONFIG_FANCY_UI */
+} /* parse_range */
+
+int issymlink(int fd, char const *fname)
+{
+#if defined(HAVE_LSTAT) && defined(CONFIG_FANCY_UI)
+	struct stat lsb, rsb;
+
+	if (fstat(fd, &rsb) < 0)
+	{
+		logf("fstat: %s: %s", fname, strerror(errno));
+		return 0;
+	} else if (lstat(fname, &lsb) < 0)
+	{
+		logf("lstat: %s: %s", fname, strerror(errno));
+		return 0;
+	}
+
+	return rsb.st_dev != lsb.st_dev || rsb.st_ino != lsb.st_ino;
+#else /* ! HAVE_LSTAT || ! CONFIG_FANCY_UI */
+	return 0;
+#endif
+} /* issymlink */
+
+char const *makeup_output_fname(struct bitstream_st const *ibs)
+{
+#ifdef CONFIG_FANCY_UI
+	static char generated_fname[PATH_MAX];
+
+	unsigned lfname, sext;
+	char const *fname, *ext;
+
+	if (ibs->stdfd)
+		return "-";
+
+	fname = ibs->fname;
+	lfname = strlen(fname);
+	if (IS_COMPRESS())
+	{
+		ext = ".bz";
+		sext = sizeof(".bz");
+	} else if (lfname > 3 && !memcmp(&fname[lfname - 3], ".bz", 3))
+	{
+		lfname -= 3;
+		ext = "";
+		sext = sizeof("");
+	} else
+	{
+		ext = ".bunz";
+		sext = sizeof(".bunz");
+	}
+
+	if (lfname + sext > sizeof(generated_fname))
+		lfname = sizeof(generated_fname) - sext;
+	memcpy(generated_fname, fname, lfname);
+	memcpy(&generated_fname[lfname], ext, sext);
+
+	return generated_fname;
+
+#else /* ! CONFIG_FANCY_UI */
+	return "-";
+#endif
+} /* makeup_output_fname */
+
+mode_t makeup_output_perms(struct bitstream_st const *bs)
+{
+#ifdef CONFIG_FANCY_UI
+	struct stat sb;
+
+	if (main_runtime.has_perms)
+		return main_runtime.perms;
+	else if (input_bs.stdfd)
+		return 0666;
+	else if (fstat(bs->fd, &sb) < 0)
+	{
+		logf("fstat: %s: %s", bs->fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	} else
+		return sb.st_mode & 0666;
+#else /* ! CONFIG_FANCY_UI */
+	return 0;
+#endif
+} /* makeup_output_perms */
+
+void bs_open_input(struct bitstream_st *bs, char const *fname)
+{
+	bs->eof = 0;
+	bs->nread = 0;
+	bs->map = NULL;
+	bs->bit_p = bs->bit_window;
+	bs->bit_end = bs->bit_window;
+
+	if (fname[0] == '-' && fname[1] == '\0')
+	{
+		bs->fd = STDIN_FILENO;
+		bs->fname = "(stdin)";
+		bs->stdfd = 1;
+		bs_setup_input(bs);
+		return;
+	}
+
+#ifdef CONFIG_FANCY_UI
+	if ((bs->fd = open(fname, O_RDONLY)) < 0)
+	{
+		logf("open: %s: %s", fname, strerror(errno));
+		goto out;
+	}
+
+	bs->fname = fname;
+	bs->stdfd = 0;
+	bs_setup_input(bs);
+	return;
+
+out:
+	bs->fname = NULL;
+	throw_exception(EXIT_ERR_OTHER);
+#endif /* CONFIG_FANCY_UI */
+} /* bs_open_input */
+
+void bs_setup_input(struct bitstream_st *bs)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+	/* Fails harmlessly on pipes. */
+	posix_fadvise(bs->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	if (!bs->stdfd)
+		bs_map_input(bs);
+	if (bs->map)
+		return;
+
+	bs_alloc_window(bs, 0);
+	bs->byte_p = bs->byte_window;
+	bs->byte_end = bs->byte_window;
+	bs->fpos = lseek(bs->fd, 0, SEEK_CUR);
+#ifdef CONFIG_IO_URING
+	/* The kernel reads ahead for us. */
+	if (bs->uring)
+		bs->fpos = -1;
+#endif
+#ifdef CONFIG_MULTITHREAD
+	/* So does our reader thread. */
+	if (bs->thread)
+		bs->fpos = -1;
+#endif
+} /* bs_setup_input */
+
+/*
+ * Regular files are mapped in their entirety and the byte window is
+ * pointed right at the mapping, so the RLE stage and the bit reader
+ * work on the page cache directly, without the copying and the
+ * read()s.  If anything goes wrong we silently stay with read().
+ * A file changed under us is for bs_sigbus() and bs_check_map().
+ */
+void bs_map_input(struct bitstream_st *bs)
+{
+#ifdef HAVE_MMAP
+	struct stat sb;
+	void *map;
+
+	if (fstat(bs->fd, &sb) < 0 || !S_ISREG(sb.st_mode)
+			|| sb.st_size <= 0
+			|| (off_t)(size_t)sb.st_size != sb.st_size)
+		return;
+
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, bs->fd, 0);
+	if (map == MAP_FAILED)
+		return;
+# if defined(HAVE_MADVISE) && defined(MADV_SEQUENTIAL)
+	madvise(map, sb.st_size, MADV_SEQUENTIAL);
+# endif
+
+	bs->map = map;
+	bs->map_size = bs->nread = sb.st_size;
+	bs->map_mtime = sb.st_mtime;
+	bs->byte_p = bs->map;
+	bs->byte_end = bs->hole_end = &bs->map[bs->map_size];
+	bs->eof = 1;
+	bs_catch_sigbus(bs);
+
+	/* Only the newer format can tell about holes. */
+	if (IS_COMPRESS() && main_runtime.member_trailer)
+		bs_find_hole(bs, 0);
+#endif /* HAVE_MMAP */
+} /* bs_map_input */
+
+#ifdef HAVE_MMAP
+/*
+ * Reading a page of a mapping past the end of its file raises SIGBUS,
+ * as when someone truncates the file we're reading.  Where read()
+ * would just have returned less, that would kill us.  So the rest of
+ * the mapping is replaced by zeros, which the access reads when it's
+ * repeated, and bs_check_map() fails when we're done with the file.
+ * Faults elsewhere are not ours and kill us as they would have.
+ */
+void bs_sigbus(int sig, siginfo_t *info, void *context)
+{
+	size_t from;
+	u_int8_t *map, *addr;
+
+	map = sigbus_map;
+	addr = info->si_addr;
+	if (!map || addr < map || addr >= &map[sigbus_map_size])
+	{
+		signal(SIGBUS, SIG_DFL);
+		return;
+	}
+
+	from = (addr - map) & ~(sigbus_pagesize - 1);
+	if (mmap(&map[from], sigbus_map_size - from, PROT_READ,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)
+		== MAP_FAILED)
+		signal(SIGBUS, SIG_DFL);
+	sigbus_truncated = 1;
+} /* bs_sigbus */
+
+/* Makes bs_sigbus() look after the mapping of `bs'. */
+void bs_catch_sigbus(struct bitstream_st const *bs)
+{
+	struct sigaction sa;
+
+	sigbus_map = bs->map;
+	sigbus_map_size = bs->map_size;
+	sigbus_truncated = 0;
+	if (sigbus_pagesize)
+		return;
+
+	sigbus_pagesize = sysconf(_SC_PAGESIZE);
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = bs_sigbus;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGBUS, &sa, NULL);
+} /* bs_catch_sigbus */
+#endif /* HAVE_MMAP */
+
+/*
+ * Fails if the file mapped to `bs' has been truncated, appended to or
+ * rewritten since it was mapped.  What we've made of it is not what's
+ * in it now, and we mustn't remove it either.
+ */
+void bs_check_map(struct bitstream_st const *bs)
+{
+#ifdef HAVE_MMAP
+	struct stat sb;
+
+	if (!bs->map || bs->memory || bs->fd < 0)
+		return;
+	if (!sigbus_truncated && fstat(bs->fd, &sb) == 0
+			&& sb.st_size == (off_t)bs->map_size
+			&& sb.st_mtime == bs->map_mtime)
+		return;
+
+	logf("%s: file changed while being read", bs->fname);
+	throw_exception(EXIT_ERR_INPUT);
+#endif /* HAVE_MMAP */
+} /* bs_check_map */
+
+/*
+ * Ends the byte window of the mapped input `bs' at the first hole
+ * at or after `pos' that is worth skipping, and sets `hole_end'.
+ * Without one, or if the filesystem can't tell, the window extends
+ * to the end of file.
+ */
+void bs_find_hole(struct bitstream_st *bs, off_t pos)
+{
+	off_t size;
+
+	size = bs->map_size;
+	bs->byte_p = &bs->map[pos];
+	bs->byte_end = bs->hole_end = &bs->map[size];
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	while (pos < size)
+	{
+		off_t hole, data;
+
+		if ((hole = lseek(bs->fd, pos, SEEK_HOLE)) < 0
+				|| hole >= size)
+			break;
+
+		/* ENXIO means the hole extends to the end of file. */
+		if ((data = lseek(bs->fd, hole, SEEK_DATA)) < 0
+				|| data > size)
+			data = size;
+		if (data - hole >= BS_MIN_HOLE)
+		{
+			bs->byte_end = &bs->map[hole];
+			bs->hole_end = &bs->map[data];
+			break;
+		}
+
+		pos = data;
+	}
+#endif /* SEEK_DATA && SEEK_HOLE */
+} /* bs_find_hole */
+
+void bs_open_output(struct bitstream_st *bs, char const *fname)
+{
+	int flags;
+	mode_t perms;
+
+	bs->blocked = main_runtime.drop_output;
+	bs->done = bs->skip = bs->limit = 0;
+	bs->bit_p = bs->bit_window;
+	bs->bit_end = AFTER_OF(bs->bit_window);
+
+	if (!fname)
+		fname = makeup_output_fname(&input_bs);
+	if (fname[0] == '-' && fname[1] == '\0')
+	{
+		bs->fd = STDOUT_FILENO;
+		bs->fname = "(stdout)";
+		bs->stdfd = 1;
+		bs_setup_output(bs);
+		return;
+	}
+
+#ifdef CONFIG_FANCY_UI
+	flags = O_CREAT | O_WRONLY | O_APPEND;
+	if (main_runtime.append)
+		;
+	else if (!main_runtime.overwrite)
+		flags |= O_EXCL;
+	else if (main_runtime.symfollow)
+		flags |= O_TRUNC;
+
+	perms = makeup_output_perms(&input_bs);
+
+	if ((bs->fd = open(fname, flags, perms)) < 0)
+	{
+		logf("open: %s: %s", fname, strerror(errno));
+		goto out0;
+	}
+	if (!main_runtime.symfollow && issymlink(bs->fd, fname))
+	{
+	
+		logf("%s: is a symlink", fname);
+		goto out1;
+	}
+	if (main_runtime.overwrite && !main_runtime.symfollow
+		&& ftruncate(bs->fd, 0) < 0)
+	{
+		logf("ftruncate: %s: %s", fname, strerror(errno));
+		goto out1;
+	}
+
+	bs->fname = fname;
+	bs->stdfd = 0;
+	bs_setup_output(bs);
+	return;
+
+out1:
+	close(bs->fd);
+	bs->fd = -1;
+out0:
+	bs->fname = NULL;
+	throw_exception(EXIT_ERR_OTHER);
+#endif /* CONFIG_FANCY_UI */
+} /* bs_create */
+
+/* Sets `bs' up for output which goes nowhere.  The window is
+ * only there to take the CRC of, so it's kept small. */
+void bs_open_nowhere(struct bitstream_st *bs)
+{
+	bs->blocked = 1;
+	bs->done = bs->skip = bs->limit = 0;
+	bs->bit_p = bs->bit_window;
+	bs->bit_end = AFTER_OF(bs->bit_window);
+
+	bs->fd = -1;
+	bs->fname = "(nowhere)";
+	bs->stdfd = 0;
+	bs_setup_output(bs);
+} /* bs_open_nowhere */
+
+void bs_setup_output(struct bitstream_st *bs)
+{
+	struct stat sb;
+
+	/* We're appending; only regular files are worth preallocating. */
+	bs->start = fstat(bs->fd, &sb) == 0 && S_ISREG(sb.st_mode)
+		? sb.st_size : -1;
+	bs->reserved = 0;
+	bs_alloc_window(bs, 1);
+	bs->byte_p = bs->byte_window;
+	bs->byte_end = &bs->byte_window[bs->byte_size];
+} /* bs_setup_output */
+
+/*
+ * (Re)allocates the byte window of `bs' according to -B or, failing
+ * that, to the type of file it is connected to.  Small requests leave
+ * most of the bandwidth of disk arrays and network filesystems unused,
+ * but pipes would not take more than a few pages at once anyway.
+ * With io_uring or an I/O thread the windows are owned by them
+ * rather than by `byte_buf'.  When compressing, the input is read
+ * by the RLE thread of compress.c, so it doesn't need another one.
+ */
+void bs_alloc_window(struct bitstream_st *bs, int output)
+{
+	size_t size;
+	int isreg;
+	struct stat sb;
+
+	isreg = fstat(bs->fd, &sb) == 0 && S_ISREG(sb.st_mode);
+	if (main_runtime.window_size)
+		size = main_runtime.window_size;
+	else if (isreg)
+		size = BS_FILE_WINDOW_SIZE;
+	else
+		size = BS_WINDOW_SIZE;
+
+#ifdef CONFIG_IO_URING
+	/* Writes to pipes may complete partially, which we couldn't
+	 * recover from with the later windows already in flight. */
+	if ((!output || isreg) && (bs->uring = uring_open(bs->fd, size,
+		output, &bs->byte_window)) != NULL)
+	{
+		free(bs->byte_buf);
+		bs->byte_buf = NULL;
+		bs->byte_size = size;
+		return;
+	}
+#endif
+#ifdef CONFIG_MULTITHREAD
+	if (output ? !bs->blocked : !IS_COMPRESS())
+	{
+		free(bs->byte_buf);
+		bs->byte_buf = NULL;
+		bs->byte_size = size;
+		bs_start_thread(bs, output);
+		return;
+	}
+#endif
+
+	if (!bs->byte_buf || size != bs->byte_size)
+	{
+		lc_recallocp(&bs->byte_buf, size);
+		bs->byte_size = size;
+	}
+	bs->byte_window = bs->byte_buf;
+} /* bs_alloc_window */
+
+/* The bodies of bs_fill_byte() and bs_flush_byte() */
+unsigned bs_read_window(struct bitstream_st *bs, int eofok)
+{
+	unsigned n;
+
+	if (bs->memory && !bs->eof)
+		/* Wait for bs_stream_push(). */
+		throw_exception(BS_NEED_INPUT);
+	if (bs->map || bs->memory)
+	{	/* The whole file, or the data up to the next hole,
+		 * has been in the window. */
+		if (!eofok)
+			unexpected_eof(bs);
+		return 0;
+	}
+
+	assert(INRANGE(bs->byte_end,
+		bs->byte_window, &bs->byte_window[bs->byte_size]));
+	assert(INRANGE(bs->byte_p, bs->byte_window, bs->byte_end));
+
+#ifdef CONFIG_IO_URING
+	if (bs->uring)
+		n = bs_read_ahead(bs);
+	else
+#endif
+#ifdef CONFIG_MULTITHREAD
+	if (bs->thread)
+		n = bs_thread_read(bs);
+	else
+#endif
+		n = bs_read(bs, bs->byte_window, bs->byte_size);
+	bs->eof = n != bs->byte_size;
+	bs->nread += n;
+
+	bs->byte_p = bs->byte_window;
+	bs->byte_end = &bs->byte_window[n];
+
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	/* Have the kernel start reading the next window while
+	 * we are busy with this one. */
+	if (bs->fpos >= 0)
+	{
+		bs->fpos += n;
+		if (!bs->eof)
+			posix_fadvise(bs->fd, bs->fpos, bs->byte_size,
+				POSIX_FADV_WILLNEED);
+	}
+#endif
+
+	if (!n && !eofok)
+		unexpected_eof(bs);
+	return n;
+} /* bs_read_window */
+
+void bs_write_window(struct bitstream_st *bs)
+{
+	off_t start;
+	u_int8_t *endp;
+
+	assert(INRANGE(bs->byte_end,
+		bs->byte_window, &bs->byte_window[bs->byte_size]));
+	assert(INRANGE(bs->byte_p, bs->byte_window, bs->byte_end));
+
+	if (bs->grow)
+	{	/* Make room after what's not been pulled yet. */
+		bs_grow_window(bs, bs->byte_p - bs->byte_window,
+			BS_WINDOW_SIZE);
+		bs->byte_end = &bs->byte_buf[bs->byte_size];
+		return;
+	}
+
+	endp = bs->byte_p;
+	bs->byte_p = bs->byte_window;
+	start = bs->done;
+	bs->done += endp - bs->byte_window;
+	if (bs->blocked)
+		return;
+
+	if (bs->memory)
+	{	/* The caller's buffer is full.  The rest of the output
+		 * is only counted, so we can tell how big it should be. */
+		if (!bs->byte_buf)
+			lc_recallocp(&bs->byte_buf, BS_WINDOW_SIZE);
+		bs->byte_window = bs->byte_p = bs->byte_buf;
+		bs->byte_size = BS_WINDOW_SIZE;
+		bs->byte_end = &bs->byte_window[bs->byte_size];
+		return;
+	}
+
+	if (bs->limit)
+	{	/* Keep only the part of the window in [skip, limit). */
+		off_t from, to;
+
+		from = MAX(start, bs->skip);
+		to = MIN(bs->done, bs->limit);
+		if (from < to)
+			memmove(bs->byte_window,
+				&bs->byte_window[from - start], to - from);
+		endp = &bs->byte_window[from < to ? to - from : 0];
+	}
+
+#ifdef CONFIG_IO_URING
+	if (bs->uring)
+	{	/* Continue in another window. */
+		bs_write_behind(bs, endp - bs->byte_window);
+		bs->byte_p = bs->byte_window;
+		bs->byte_end = &bs->byte_window[bs->byte_size];
+		return;
+	}
+#endif
+#ifdef CONFIG_MULTITHREAD
+	if (bs->thread)
+	{
+		bs_thread_write(bs, endp - bs->byte_window);
+		bs->byte_p = bs->byte_window;
+		bs->byte_end = &bs->byte_window[bs->byte_size];
+		return;
+	}
+#endif
+
+	bs_write(bs, bs->byte_window, endp - bs->byte_window);
+} /* bs_write_window */
+
+/* Puts `size' zeros through the byte window of `bs'. */
+void bs_zero_window(struct bitstream_st *bs, size_t size)
+{
+	while (size > 0)
+	{
+		size_t n;
+
+		if (bs->byte_p == bs->byte_end)
+			bs_flush_byte(bs);
+		n = MIN(size, (size_t)(bs->byte_end - bs->byte_p));
+		memset(bs->byte_p, 0, n);
+		bs->byte_p += n;
+		size -= n;
+	}
+} /* bs_zero_window */
+
+/*
+ * Moves the first `keep' bytes of the window of the stream `bs' to
+ * the beginning of its buffer, and makes it larger if there's not
+ * room for `room' more after them.  byte_p and byte_end are moved
+ * with the bytes.  lc_recallocp() would clear what we keep.
+ */
+void bs_grow_window(struct bitstream_st *bs, size_t keep, size_t room)
+{
+	size_t size, p, end;
+
+	p = bs->byte_p - bs->byte_window;
+	end = bs->byte_end - bs->byte_window;
+	if (bs->byte_window > bs->byte_buf)
+		memmove(bs->byte_buf, bs->byte_window, keep);
+
+	size = bs->byte_size ? bs->byte_size : room;
+	while (size - keep < room)
+		size *= 2;
+	if (size != bs->byte_size)
+	{
+		u_int8_t *buf;
+
+		if (!(buf = realloc(bs->byte_buf, size)))
+		{
+			logf("realloc(%u): %s", (unsigned)size,
+				strerror(errno));
+			throw_exception(EXIT_ERR_OTHER);
+		}
+		bs->byte_buf = buf;
+		bs->byte_size = size;
+	}
+
+	bs->byte_window = bs->byte_buf;
+	bs->byte_p = &bs->byte_buf[p];
+	bs->byte_end = &bs->byte_buf[end];
+} /* bs_grow_window */
+
+/*
+ * Skips `size' bytes of the regular file `fd' and makes it longer if
+ * necessary.  The new part is a hole, except if bs_preallocate() has
+ * reserved space for it, which we give back.  Files we've opened are
+ * appended to, but the shell may give us any descriptor for stdout.
+ * Returns 0 or errno.
+ */
+int bs_extend(int fd, off_t size)
+{
+	int flags;
+	off_t from;
+	struct stat sb;
+
+	if ((flags = fcntl(fd, F_GETFL)) < 0 || fstat(fd, &sb) < 0)
+		return errno;
+	if (flags & O_APPEND)
+		from = sb.st_size;
+	else if ((from = lseek(fd, size, SEEK_CUR) - size) < 0)
+		return errno;
+
+	if (from + size > sb.st_size && ftruncate(fd, from + size) < 0)
+		return errno;
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE)
+	fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		from, size);
+#endif
+	return 0;
+} /* bs_extend */
+
+unsigned bs_read(struct bitstream_st const *bs, void *data, size_t size)
+{
+	int n;
+
+	if ((n = CANCELLABLE(read(bs->fd, data, size))) < 0)
+	{
+		logf("read: %s: %s", bs->fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+
+	return n;
+} /* bs_read */
+
+void bs_write(struct bitstream_st *bs, void const *data, size_t size)
+{
+	if (CANCELLABLE(write(bs->fd, data, size)) < 0)
+	{
+		logf("write: %s: %s", bs->fname, strerror(errno));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+} /* bs_write */
+
+#ifdef CONFIG_IO_URING
+unsigned bs_read_ahead(struct bitstream_st *bs)
+{
+	int n;
+
+	if ((n = uring_read(bs->uring, &bs->byte_window)) < 0)
+	{
+		logf("read: %s: %s", bs->fname, strerror(-n));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+
+	return n;
+} /* bs_read_ahead */
+
+void bs_write_behind(struct bitstream_st *bs, size_t size)
+{
+	int err;
+
+	if ((err = uring_write(bs->uring, &bs->byte_window, size)) < 0)
+	{
+		logf("write: %s: %s", bs->fname, strerror(-err));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+} /* bs_write_behind */
+#endif /* CONFIG_IO_URING */
+
+#ifdef CONFIG_MULTITHREAD
+/* Sets up `bs->thread' for `bs->byte_size' windows and starts it. */
+void bs_start_thread(struct bitstream_st *bs, int output)
+{
+	unsigned i;
+	struct bs_thread_st *thread;
+
+	thread = NULL;
+	lc_recallocp(&thread, sizeof(*thread));
+	thread->bs = bs;
+	thread->output = output;
+	ring_init(&thread->full);
+	ring_init(&thread->free);
+	bs->thread = thread;
+
+	for (i = 0; i < MEMBS_OF(thread->windows); i++)
+		lc_recallocp(&thread->windows[i].buf, bs->byte_size);
+
+	/* Outputs start writing the first window, inputs
+	 * only look at it until the first bs_fill_byte(). */
+	i = 0;
+	if (output)
+		thread->handed = &thread->windows[i++];
+	for (; i < MEMBS_OF(thread->windows); i++)
+		ring_push(&thread->free, &thread->windows[i]);
+	bs->byte_window = thread->windows[0].buf;
+
+	worker_start(&thread->worker, output ? bs_writer : bs_reader,
+		thread, &thread->full, &thread->free);
+} /* bs_start_thread */
+
+/*
+ * Lets the writer finish or stops the reader, then releases the
+ * windows.  Returns the error of the writes not yet reported.
+ */
+int bs_stop_thread(struct bitstream_st *bs)
+{
+	int err;
+	unsigned i;
+	struct bs_thread_st *thread;
+
+	thread = bs->thread;
+	if (thread->output)
+	{
+		ring_push(&thread->full, NULL);
+		worker_join(&thread->worker);
+	} else
+		worker_stop(&thread->worker);
+
+	err = 0;
+	for (i = 0; i < MEMBS_OF(thread->windows); i++)
+	{
+		if (thread->output && !thread->failed && !err)
+			err = thread->windows[i].err;
+		free(thread->windows[i].buf);
 	}
 
-	bs->fname = fname;
-	bs->stdfd = 0;
-	return;
+	ring_destroy(&thread->full);
+	ring_destroy(&thread->free);
+	free(thread);
+	bs->thread = NULL;
+	bs->byte_window = NULL;
 
-out:
-	bs->fname = NULL;
-	throw_exception(EXIT_ERR_OTHER);
-#endif /* CONFIG_FANCY_UI */
-} /* bs_open_input */
+	return err;
+} /* bs_stop_thread */
 
-void bs_open_output(struct bitstream_st *bs, char const *fname)
+/* Gives back the current window and returns the next one
+ * from the reader. */
+unsigned bs_thread_read(struct bitstream_st *bs)
 {
-	int flags;
-	mode_t perms;
+	struct bs_thread_st *thread;
+	struct bs_window_st *window;
 
-	bs->blocked = main_runtime.drop_output;
-	bs->byte_p = bs->byte_window;
-	bs->byte_end = AFTER_OF(bs->byte_window);
-	bs->bit_p = bs->bit_window;
-	bs->bit_end = AFTER_OF(bs->bit_window);
+	thread = bs->thread;
+	if (thread->eof)
+		return 0;
 
-	if (!fname)
-		fname = makeup_output_fname(&input_bs);
-	if (fname[0] == '-' && fname[1] == '\0')
+	if (thread->handed)
+		ring_push(&thread->free, thread->handed);
+	if (!(thread->handed = window = ring_pop(&thread->full)))
+		/* We're being stopped. */
+		throw_exception(EXIT_ERR_OTHER);
+
+	if (window->err)
 	{
-		bs->fd = STDOUT_FILENO;
-		bs->fname = "(stdout)";
-		bs->stdfd = 1;
-		return;
+		logf("read: %s: %s", bs->fname, strerror(window->err));
+		throw_exception(EXIT_ERR_OTHER);
 	}
 
-#ifdef CONFIG_FANCY_UI
-	flags = O_CREAT | O_WRONLY | O_APPEND;
-	if (main_runtime.append)
-		;
-	else if (!main_runtime.overwrite)
-		flags |= O_EXCL;
-	else if (main_runtime.symfollow)
-		flags |= O_TRUNC;
+	thread->eof = window->len < bs->byte_size;
+	bs->byte_window = window->buf;
+	return window->len;
+} /* bs_thread_read */
 
-	perms = makeup_output_perms(&input_bs);
+/* Hands the first `size' bytes of the current window to the writer
+ * and continues with a free one. */
+void bs_thread_write(struct bitstream_st *bs, size_t size)
+{
+	struct bs_thread_st *thread;
+	struct bs_window_st *window;
+
+	thread = bs->thread;
+	thread->handed->len = size;
+	ring_push(&thread->full, thread->handed);
+	if (!(thread->handed = window = ring_pop(&thread->free)))
+		/* We're being stopped.  The window we had is the
+		 * writer's now, so we must not touch it again. */
+		throw_exception(EXIT_ERR_OTHER);
 
-	if ((bs->fd = open(fname, flags, perms)) < 0)
-	{
-		logf("open: %s: %s", fname, strerror(errno));
-		goto out0;
-	}
-	if (!main_runtime.symfollow && issymlink(bs->fd, fname))
+	if (window->err)
 	{
-	
-		logf("%s: is a symlink", fname);
-		goto out1;
+		logf("write: %s: %s", bs->fname, strerror(window->err));
+		thread->failed = 1;
+		throw_exception(EXIT_ERR_OTHER);
 	}
-	if (main_runtime.overwrite && !main_runtime.symfollow
-		&& ftruncate(bs->fd, 0) < 0)
+
+	bs->byte_window = window->buf;
+} /* bs_thread_write */
+
+/* Fills free windows until the end of file or an error. */
+void *bs_reader(void *threadp)
+{
+	struct bs_thread_st *thread;
+	struct bs_window_st *window;
+
+	thread = threadp;
+	while ((window = ring_pop(&thread->free)) != NULL)
 	{
-		logf("ftruncate: %s: %s", fname, strerror(errno));
-		goto out1;
-	}
+		int eof;
 
-	bs->fname = fname;
-	bs->stdfd = 0;
-	return;
+		/* Pipes return what they have, but short windows
+		 * would look like the end of the input. */
+		eof = 0;
+		window->len = 0;
+		while (window->len < thread->bs->byte_size)
+		{
+			ssize_t n;
+
+			n = CANCELLABLE(read(thread->bs->fd,
+				&window->buf[window->len],
+				thread->bs->byte_size - window->len));
+			if (n < 0)
+			{
+				window->err = errno;
+				eof = 1;
+				break;
+			} else if (n == 0)
+			{
+				eof = 1;
+				break;
+			}
+
+			window->len += n;
+		}
 
-out1:
-	close(bs->fd);
-	bs->fd = -1;
-out0:
-	bs->fname = NULL;
-	throw_exception(EXIT_ERR_OTHER);
-#endif /* CONFIG_FANCY_UI */
-} /* bs_create */
+		ring_push(&thread->full, window);
+		if (eof)
+			break;
+	}
 
-unsigned bs_read(struct bitstream_st const *bs, void *data, size_t size)
+	return NULL;
+} /* bs_reader */
+
+/* Writes the full windows until the end of stream. */
+void *bs_writer(void *threadp)
 {
-	int n;
+	int err;
+	struct bs_thread_st *thread;
+	struct bs_window_st *window;
 
-	if ((n = read(bs->fd, data, size)) < 0)
+	err = 0;
+	thread = threadp;
+	while ((window = ring_pop(&thread->full)) != NULL)
 	{
-		logf("read: %s: %s", bs->fname, strerror(errno));
-		throw_exception(EXIT_ERR_OTHER);
+		size_t done;
+
+		if (!err && window->hole)
+			err = bs_extend(thread->bs->fd, window->hole);
+		window->hole = 0;
+
+		for (done = 0; !err && done < window->len; )
+		{
+			ssize_t n;
+
+			n = CANCELLABLE(write(thread->bs->fd,
+				&window->buf[done], window->len - done));
+			if (n < 0)
+				err = errno;
+			else
+				done += n;
+		}
+
+		window->err = err;
+		ring_push(&thread->free, window);
 	}
 
-	return n;
-} /* bs_read */
+	return NULL;
+} /* bs_writer */
+#endif /* CONFIG_MULTITHREAD */
 
-void bs_write(struct bitstream_st *bs, void const *data, size_t size)
+/* main() may not have run when the *_buffer() and the stream functions
+ * are called, maybe from more than one thread. */
+void crc_init_once(void)
 {
-	if (write(bs->fd, data, size) < 0)
+#ifdef CONFIG_MULTITHREAD
+	pthread_once(&crc_once, crc_init);
+#else
+	static int done;
+
+	if (!done)
 	{
-		logf("write: %s: %s", bs->fname, strerror(errno));
-		throw_exception(EXIT_ERR_OTHER);
+		crc_init();
+		done = 1;
 	}
-} /* bs_write */
+#endif
+} /* crc_init_once */
 
 void bs_crc_init(struct bitstream_st *bs)
 {
 	bs->crc = ~0;
 } /* bs_crc_init */
 
-void bs_align(struct bitstream_st *bs)
+/* Returns the number of bytes output to `bs' so far, including
+ * the ones still in its windows. */
+off_t bs_output_size(struct bitstream_st const *bs)
 {
-	unsigned d;
-
-	d = (bs->bit_p - bs->bit_window) % 8;
-	if (d == 0)
-		return;
-	for (d = 8 - d; d > 0; d--)
-		*bs->bit_p++ = 0;
-} /* bs_align */
+	return bs->done + (bs->byte_p - bs->byte_window)
+		+ (bs->bit_p - bs->bit_window) / BITS_OF(u_int8_t);
+} /* bs_output_size */
 
 int bs_eof(struct bitstream_st *bs)
 {
@@ -519,7 +2002,59 @@ void bs_close(struct bitstream_st *bs)
 	if (!bs->fname || bs->fd < 0)
 		return;
 
+#ifdef HAVE_MMAP
+	if (bs->map)
+	{
+		if (bs->map == sigbus_map)
+			sigbus_map = NULL;
+		munmap(bs->map, bs->map_size);
+		bs->map = NULL;
+	}
+#endif
+
 	failed = 0;
+#ifdef CONFIG_IO_URING
+	if (bs->uring)
+	{
+		int err;
+
+		/* Outstanding writes may fail too. */
+		if ((err = uring_close(bs->uring)) < 0)
+		{
+			logf("write: %s: %s", bs->fname, strerror(-err));
+			failed = 1;
+		}
+		bs->uring = NULL;
+	}
+#endif
+#ifdef CONFIG_MULTITHREAD
+	if (bs->thread)
+	{
+		int err;
+
+		if ((err = bs_stop_thread(bs)) != 0)
+		{
+			logf("write: %s: %s", bs->fname, strerror(err));
+			failed = 1;
+		}
+	}
+#endif
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	/* Give back what bs_preallocate() has reserved past the end of
+	 * the file, because the member was shorter than it said or
+	 * failed.  Truncating to the same size does that. */
+	if (bs->reserved > 0)
+	{
+		struct stat sb;
+
+		if (fstat(bs->fd, &sb) == 0 && sb.st_size < bs->reserved
+				&& ftruncate(bs->fd, sb.st_size) < 0)
+			logf("ftruncate: %s: %s", bs->fname,
+				strerror(errno));
+		bs->reserved = 0;
+	}
+#endif
+
 #ifdef CONFIG_FANCY_UI
 	if (!bs->stdfd && close(bs->fd) < 0)
 	{
@@ -536,6 +2071,7 @@ void bs_close(struct bitstream_st *bs)
 
 void bs_close_input(struct bitstream_st *bs)
 {
+	bs_check_map(bs);
 #ifdef CONFIG_FANCY_UI
 	if (!bs->stdfd && !main_runtime.keep_input
 		&& unlink(bs->fname) < 0)
@@ -560,20 +2096,257 @@ void bs_close_output(struct bitstream_st *bs)
 	bs_close(bs);
 } /* bs_close_output */
 
-void bzip(struct bitstream_st *ibs, struct bitstream_st *obs)
+/* Makes `buf' the byte window of `bs', to be read from or, if `output',
+ * written to.  Nothing is to be closed afterwards, only the byte_buf
+ * bs_flush_byte() may allocate for an output which doesn't fit. */
+void bs_open_memory(struct bitstream_st *bs,
+	void const *buf, size_t size, int output)
+{
+	memset(bs, 0, sizeof(*bs));
+	bs->memory = 1;
+	bs->fd = -1;
+	bs->fname = "(memory)";
+	bs->start = bs->fpos = -1;
+
+	bs->byte_window = bs->byte_p = (u_int8_t *)buf;
+	bs->byte_size = size;
+	bs->byte_end = &bs->byte_window[size];
+	if (output)
+	{
+		bs->bit_p = bs->bit_window;
+		bs->bit_end = AFTER_OF(bs->bit_window);
+	} else
+	{	/* Like a mapped file, whose size is known. */
+		bs->map = size ? bs->byte_window : NULL;
+		bs->map_size = bs->nread = size;
+		bs->hole_end = bs->byte_end;
+		bs->eof = 1;
+		bs->bit_p = bs->bit_end = bs->bit_window;
+	}
+} /* bs_open_memory */
+
+/* Compresses `ibs' to `obs' as one member, with a trailer
+ * if `trailer'.  Returns how many bytes the member took. */
+off_t bzip_member(struct compress_st *cx, int trailer,
+	struct bitstream_st *ibs, struct bitstream_st *obs)
 {
 #ifdef CONFIG_COMPRESS
+	off_t start;
+	struct member_st member;
+
+	start = bs_output_size(obs);
 	bs_crc_init(ibs);
-	compress();
+	compress(cx);
+	/* Before the trailer makes it look all right. */
+	bs_check_map(ibs);
 	bs_align(obs);
+
+	if (trailer)
+	{
+		member.usize = ibs->nread;
+		member.crc = ~ibs->crc;
+		member.csize = bs_output_size(obs) - start
+			+ MEMBER_TRAILER_SIZE;
+		member_put_trailer(obs, &member);
+	}
+
+	return bs_output_size(obs) - start;
+#else /* ! CONFIG_COMPRESS */
+	return 0;
+#endif
+} /* bzip_member */
+
+void bzip(struct bitstream_st *ibs, struct bitstream_st *obs)
+{
+#ifdef CONFIG_COMPRESS
+	/* Kept from file to file, so the blocks are allocated once. */
+	static struct compress_st *cx;
+	off_t size;
+
+	if (!cx)
+	{
+		struct compress_params_st params;
+
+		params.ibs = ibs;
+		params.obs = obs;
+		params.level = main_runtime.compression_level;
+		params.nthreads = main_runtime.compress_threads;
+		params.sort_threads = main_runtime.sort_threads;
+		params.member_trailer = main_runtime.member_trailer;
+		params.block_crcs = main_runtime.block_crcs;
+		params.stats = main_runtime.verbose ? &file_stats : NULL;
+		params.block_stats = main_runtime.verbose > 1;
+		cx = compress_new(&params);
+	}
+
+	/* The blocks don't know about the header and the trailer. */
+	size = bzip_member(cx, main_runtime.member_trailer, ibs, obs);
+	if (main_runtime.verbose)
+		file_stats.out = size;
 #endif
 } /* bzip */
 
+/* Decompresses the next member of `ibs' and checks its trailer,
+ * if it has one.  Says in *member what we've seen. */
+void bunzip_member(struct decompress_st *dx,
+	struct bitstream_st *ibs, struct bitstream_st *obs,
+	struct member_st *member)
+{
+#ifdef CONFIG_DECOMPRESS
+	int trailer;
+	off_t cstart, ustart;
+
+	cstart = bs_tell_bit(ibs);
+	ustart = bs_output_size(obs);
+	bs_crc_init(obs);
+	trailer = decompress(dx, member);
+	bs_align(ibs);
+
+	if (member->usize >= 0
+		&& member->usize != bs_output_size(obs) - ustart)
+	{
+		logf("%s: invalid member header", ibs->fname);
+		throw_exception(EXIT_ERR_INPUT);
+	}
+
+	member->offset = cstart / BITS_OF(u_int8_t);
+	member->csize = (bs_tell_bit(ibs) - cstart) / BITS_OF(u_int8_t);
+	member->usize = bs_output_size(obs) - ustart;
+	member->crc = ~obs->crc;
+	if (trailer)
+	{
+		member->csize += MEMBER_TRAILER_SIZE;
+		member_check_trailer(ibs, member);
+	}
+#endif /* CONFIG_DECOMPRESS */
+} /* bunzip_member */
+
+void print_member(char const *what, struct member_st const *member)
+{
+	unsigned ratio;
+
+	/* In per mille, like gzip -l. */
+	ratio = member->usize > 0 && member->csize < member->usize
+		? 1000 - (member->csize * 1000 / member->usize) : 0;
+	/* The total has no level and no offset. */
+	printf("%9s ", what);
+	if (member->level)
+		printf("%12lld", (long long)member->offset);
+	else
+		printf("%12s", "");
+	printf(" %12lld %12lld %4u.%u%%", (long long)member->csize,
+		(long long)member->usize, ratio / 10, ratio % 10);
+	if (member->level)
+		printf(" %5u %08x", member->level, member->crc);
+	putchar('\n');
+} /* print_member */
+
+/*
+ * Prints the members of `ibs'.  If it's a regular file and all its
+ * members have a trailer, it's done by reading the trailers only.
+ * Otherwise we have no choice but to decompress everything.
+ */
+void list_members(struct decompress_st *dx,
+	struct bitstream_st *ibs, struct bitstream_st *obs)
+{
+#ifdef CONFIG_DECOMPRESS
+	unsigned i, n;
+	char what[16];
+	struct member_st *members, member, total;
+
+	printf("%s:\n%9s %12s %12s %12s %6s %5s %8s\n", ibs->fname,
+		"fragment", "offset", "compressed", "uncompressed",
+		"ratio", "level", "crc");
+
+	memset(&total, 0, sizeof(total));
+	if ((members = member_directory(ibs, &n)) != NULL)
+	{
+		for (i = 0; i < n; i++)
+		{
+			snprintf(what, sizeof(what), "%u", i + 1);
+			print_member(what, &members[i]);
+			total.csize += members[i].csize;
+			total.usize += members[i].usize;
+		}
+		free(members);
+	} else for (n = 0; !bs_eof(ibs); )
+	{
+		bunzip_member(dx, ibs, obs, &member);
+		snprintf(what, sizeof(what), "%u", ++n);
+		print_member(what, &member);
+		total.csize += member.csize;
+		total.usize += member.usize;
+	}
+
+	print_member("total", &total);
+#endif /* CONFIG_DECOMPRESS */
+} /* list_members */
+
 void bunzip(struct bitstream_st *ibs, struct bitstream_st *obs)
 {
 #ifdef CONFIG_DECOMPRESS
+	/* Kept from file to file, like bzip()'s. */
+	static struct decompress_st *dx;
+	off_t csize;
+	struct member_st member;
+# ifdef CONFIG_FANCY_UI
+	unsigned nmembers;
+	struct member_st *members;
+# endif
+
+	if (!dx)
+	{
+		struct decompress_params_st params;
+
+		params.ibs = ibs;
+		params.obs = obs;
+		params.index_blocks = main_runtime.index_fname
+			&& !main_runtime.has_range;
+		params.pipeline = 1;
+		params.stats = main_runtime.verbose ? &file_stats : NULL;
+		params.block_stats = main_runtime.verbose > 1;
+		dx = decompress_new(&params);
+	}
+
 # ifdef CONFIG_FANCY_UI
-	if (main_runtime.decompress_frag)
+	if (main_runtime.list)
+	{
+		list_members(dx, ibs, obs);
+		return;
+	}
+
+	if (main_runtime.has_range)
+	{
+		unsigned nentries;
+		struct index_entry_st *entries;
+
+		entries = index_load(main_runtime.index_fname, &nentries);
+		decompress_range(dx, entries, nentries,
+			main_runtime.range_from, main_runtime.range_len);
+		free(entries);
+		return;
+	}
+
+	if (main_runtime.index_fname)
+		index_create(main_runtime.index_fname);
+
+	if (main_runtime.decompress_frag > 1
+		&& (members = member_directory(ibs, &nmembers)) != NULL)
+	{	/* Go straight to the fragment. */
+		off_t offset;
+
+		if (main_runtime.decompress_frag > nmembers)
+		{
+			free(members);
+			logf("%s: there are only %u fragments",
+				ibs->fname, nmembers);
+			throw_exception(EXIT_ERR_INPUT);
+		}
+
+		offset = members[main_runtime.decompress_frag - 1].offset;
+		free(members);
+		bs_seek_bit(ibs, offset * BITS_OF(u_int8_t));
+	} else if (main_runtime.decompress_frag)
 	{
 		unsigned i;
 		int blocked;
@@ -581,27 +2354,123 @@ void bunzip(struct bitstream_st *ibs, struct bitstream_st *obs)
 		blocked = output_bs.blocked;
 		output_bs.blocked = 1;
 		for (i = main_runtime.decompress_frag; i > 1; i--)
-		{
-			bs_crc_init(obs);
-			decompress();
-			bs_align(ibs);
-		}
+			bunzip_member(dx, ibs, obs, &member);
 		output_bs.blocked = blocked;
 		bs_rewind(obs);
 	}
 # endif /* CONFIG_FANCY_UI */
 
+	csize = 0;
 	do
 	{
-		bs_crc_init(obs);
-		decompress();
-		bs_align(ibs);
+		bunzip_member(dx, ibs, obs, &member);
+		csize += member.csize;
 		if (main_runtime.decompress_frag)
 			break;
 	} while (!bs_eof(ibs));
+	if (main_runtime.verbose)
+		file_stats.in = csize;
+
+# ifdef CONFIG_FANCY_UI
+	if (main_runtime.index_fname)
+		index_finish();
+# endif
 #endif /* CONFIG_DECOMPRESS */
 } /* bunzip */
 
+/*
+ * Decompresses `fname' to nowhere, which checks all its CRCs, and
+ * says how it went and how fast.  Runs in a child of verify_inputs(),
+ * so it has the globals to itself.
+ */
+int verify_input(char const *fname)
+{
+	int errcode;
+	double secs;
+	off_t size;
+	struct timeval start, end;
+
+	if ((errcode = setjmp(exception_handler)) != 0)
+	{
+		printf("%s: FAILED\n", fname);
+		return errcode;
+	}
+
+	gettimeofday(&start, NULL);
+	bs_open_input(&input_bs, fname);
+	bs_open_nowhere(&output_bs);
+	bunzip(&input_bs, &output_bs);
+	size = bs_output_size(&output_bs);
+	gettimeofday(&end, NULL);
+
+	secs = (end.tv_sec - start.tv_sec)
+		+ (end.tv_usec - start.tv_usec) / 1e6;
+	printf("%s: ok, %lld bytes in %.2fs, %.1f MB/s\n", fname,
+		(long long)size, secs,
+		secs > 0 ? size / secs / (1024 * 1024) : 0.0);
+	return EXIT_HAPPILY;
+} /* verify_input */
+
+/*
+ * Checks the inputs in as many child processes at a time as -j says,
+ * or as there are processors.  bunzip() works on the global bitstreams,
+ * so it couldn't be run by more threads at once, but the children share
+ * nothing.  Each of them prints its own status line; they're short
+ * enough to come out in one piece.  Returns the exit code of the last
+ * failed one, if any.
+ */
+int verify_inputs(char const *const *inputs)
+{
+	int status, last_error;
+	unsigned njobs, running;
+
+	if (!(njobs = main_runtime.sort_threads))
+		njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (njobs < 1)
+		njobs = 1;
+
+	last_error = 0;
+	running = 0;
+	fflush(stdout);
+	while (*inputs || running > 0)
+	{
+		pid_t pid;
+
+		if (*inputs && running < njobs)
+		{
+			if ((pid = fork()) == 0)
+			{
+				status = verify_input(*inputs);
+				fflush(stdout);
+				_exit(status);
+			} else if (pid < 0)
+			{
+				logf("fork: %s", strerror(errno));
+				if (!running)
+					return EXIT_ERR_OTHER;
+			} else
+			{
+				inputs++;
+				running++;
+				continue;
+			}
+		}
+
+		if ((pid = wait(&status)) < 0)
+		{
+			logf("wait: %s", strerror(errno));
+			return EXIT_ERR_OTHER;
+		}
+		running--;
+		if (!WIFEXITED(status))
+			last_error = EXIT_ERR_INSIDE;
+		else if (WEXITSTATUS(status) != EXIT_HAPPILY)
+			last_error = WEXITSTATUS(status);
+	} /* while */
+
+	return last_error;
+} /* verify_inputs */
+
 void parse_cmdline(int argc, char *argv[])
 {
 	static char const *empty_input[] = { "-", NULL };
@@ -644,6 +2513,25 @@ void parse_cmdline(int argc, char *argv[])
 			main_runtime.compression_level = optchar - '0';
 			break;
 
+#ifdef CONFIG_MULTITHREAD
+		case OPS_SORT_THREADS:
+			main_runtime.sort_threads = lc_atou(optarg, 10);
+			if (!INRANGE(main_runtime.sort_threads, 1,
+					MAX_SORT_THREADS))
+				die(EXIT_ERR_USER, "%s: invalid number "
+					"of threads", optarg);
+			break;
+#endif
+
+		case OPS_MEMBER_TRAILER:
+			main_runtime.member_trailer = 1;
+			break;
+
+		case OPS_BLOCK_CRC:
+			main_runtime.member_trailer = 1;
+			main_runtime.block_crcs = 1;
+			break;
+
 		case OPS_DECOMPRESS:
 			main_runtime.compression_level = 0;
 			break;
@@ -654,12 +2542,32 @@ void parse_cmdline(int argc, char *argv[])
 				= lc_atou(optarg, 10);
 			break;
 
+		case OPS_INDEX:
+			main_runtime.index_fname = optarg;
+			break;
+
+		case OPS_RANGE:
+			main_runtime.compression_level = 0;
+			parse_range(optarg);
+			break;
+
 		/* I/O options */
 		case OPS_OUTPUT:
 			main_runtime.output = optarg;
 			main_runtime.keep_input = 1;
 			break;
 
+		case OPS_VERIFY:
+			main_runtime.verify = 1;
+			main_runtime.compression_level = 0;
+			main_runtime.keep_input = 1;
+			break;
+
+		case OPS_LIST:
+			main_runtime.list = 1;
+			main_runtime.compression_level = 0;
+			/* Nothing is written but the listing. */
+
 		case OPS_DEVNULL:
 			main_runtime.drop_output = 1;
 
@@ -673,6 +2581,15 @@ void parse_cmdline(int argc, char *argv[])
 			main_runtime.has_perms = 1;
 			break;
 
+		case OPS_WINDOW_SIZE:
+			main_runtime.window_size = lc_atou(optarg, 10);
+			if (!INRANGE(main_runtime.window_size, 1,
+					BS_MAX_WINDOW_SIZE / 1024))
+				die(EXIT_ERR_USER, "%s: invalid buffer size",
+					optarg);
+			main_runtime.window_size *= 1024;
+			break;
+
 		case OPS_TOLERANT:
 			main_runtime.tolerant = 1;
 			break;
@@ -716,6 +2633,14 @@ void parse_cmdline(int argc, char *argv[])
 			break;
 
 		/* Common options */
+		case OPS_VERBOSE:
+			main_runtime.verbose++;
+			break;
+
+		case OPS_STATS_JSON:
+			main_runtime.stats_json = 1;
+			break;
+
 		case OPS_VERSION:
 			printf("bzip %s\nConfigured features: %s\n",
 				bzip_version, CONFIG_FEATURES);
@@ -736,6 +2661,28 @@ void parse_cmdline(int argc, char *argv[])
 	main_runtime.inputs = argv[optind] == NULL
 		? empty_input : (char const **)&argv[optind];
 
+	if (main_runtime.stats_json && !main_runtime.verbose)
+		main_runtime.verbose = 1;
+	if (main_runtime.has_range && !main_runtime.index_fname)
+		die(EXIT_ERR_USER, "-%c needs an index (-%c)",
+			OPS_RANGE, OPS_INDEX);
+	if (main_runtime.verify && (main_runtime.index_fname
+			|| main_runtime.list || main_runtime.decompress_frag))
+		die(EXIT_ERR_USER, "-%c checks whole files only",
+			OPS_VERIFY);
+	if (main_runtime.index_fname)
+	{
+		if (main_runtime.compression_level > 0)
+			die(EXIT_ERR_USER, "-%c is for decompression only",
+				OPS_INDEX);
+		if (main_runtime.decompress_frag)
+			die(EXIT_ERR_USER, "-%c and -%c don't mix",
+				OPS_INDEX, OPS_DECOMPRESS_FRAG);
+		if (main_runtime.inputs[1])
+			die(EXIT_ERR_USER, "-%c takes a single input",
+				OPS_INDEX);
+	}
+
 #else /* ! CONFIG_FANCY_UI */
 	main_runtime.inputs = empty_input;
 #endif
@@ -747,7 +2694,7 @@ void parse_cmdline(int argc, char *argv[])
 #endif
 #ifndef CONFIG_DECOMPRESS
 	if (!main_runtime.compression_level)
-		dief(EXIT_ERR_USER, "this version will not "
+		die(EXIT_ERR_USER, "this version will not "
 			"decompress anything.");
 #endif
 } /* parse_cmdline */
@@ -773,12 +2720,19 @@ int main(int argc, char *argv[])
 
 	/* Parsing command line */
 	bzip_prgname = basename(argv[0]);
+	crc_init_once();
 	parse_cmdline(argc, argv);
 
+	if (main_runtime.verify)
+		exit(verify_inputs(main_runtime.inputs));
+
 	/* The exception handler */
 	last_error = 0;
 	if ((errcode = setjmp(exception_handler)) != 0)
 	{
+#ifdef CONFIG_MULTITHREAD
+		stop_threads();
+#endif
 		bs_close(&input_bs);
 		bs_close(&output_bs);
 
@@ -790,10 +2744,22 @@ int main(int argc, char *argv[])
 	/* The main loop */
 	for (inputs = main_runtime.inputs; (input = *inputs++) != NULL; )
 	{
+		char const *fname;
+		double start;
+
 		bs_open_input(&input_bs, input);
 		if (!main_runtime.output || !output_bs.fname)
 			bs_open_output(&output_bs, main_runtime.output);
 
+		fname = input_bs.fname;
+		start = 0;
+		if (main_runtime.verbose)
+		{
+			memset(&file_stats, 0, sizeof(file_stats));
+			input_bs.timed = output_bs.timed = 1;
+			start = stats_now();
+		}
+
 		if (IS_COMPRESS())
 			bzip(&input_bs, &output_bs);
 		else
@@ -802,6 +2768,10 @@ int main(int argc, char *argv[])
 		if (!main_runtime.output || !*inputs)
 			bs_close_output(&output_bs);
 		bs_close_input(&input_bs);
+
+		if (main_runtime.verbose)
+			stats_report(fname, 0, &file_stats,
+				stats_now() - start);
 	} /* while */
 
 	exit(last_error);
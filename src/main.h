@@ -7,12 +7,26 @@
 
 #include <unistd.h>
 #include <sys/types.h>
+#include <setjmp.h>
 
 /* Standard definitions */
 #define NOINLINE(func)		((void (*)())func)
 #define NOINLINE_T(type, func)	((type (*)())func)
 
+/* Threads sorting the blocks while compressing, by default and
+ * at most.  Each one costs a block of memory. */
+#define DFLT_SORT_THREADS		4
+#define MAX_SORT_THREADS		8
+
 /* Macros */
+/* For the state of the stages which may be running in more than one
+ * thread at once, each working on its own block */
+#ifdef CONFIG_MULTITHREAD
+# define THREAD_LOCAL		__thread
+#else
+# define THREAD_LOCAL		/* */
+#endif
+
 #if defined(CONFIG_COMPRESS) && defined(CONFIG_DECOMPRESS)
 # define IS_COMPRESS()		(main_runtime.compression_level > 0)
 #elif defined(CONFIG_COMPRESS)
@@ -34,10 +48,52 @@ struct main_runtime_st
 	int drop_output, has_perms;
 	mode_t perms;
 
-	unsigned compression_level, compress_threads;
+	unsigned compression_level, compress_threads, sort_threads;
+	unsigned window_size;
 	unsigned decompress_frag;
+	int member_trailer, block_crcs, list, verify;
+
+	/* Block index to make (-i) or to extract a range with (-r) */
+	char const *index_fname;
+	int has_range;
+	off_t range_from, range_len;
 
 	int tolerant, keep_input, symfollow, overwrite, append;
+
+	/* How many -v's, and whether the statistics are in JSON (-J) */
+	unsigned verbose;
+	int stats_json;
+};
+
+/*
+ * What compress() is to do: compress `ibs' into `obs' at `level', with
+ * `sort_threads' sorters (0 for the default), and with a trailer and
+ * CRCs after the blocks if asked for, like -M and -e.  If `stats' is
+ * given the stages are timed and added to it, and each block is reported
+ * if `block_stats'.  The rest of the compressor's state is private to its
+ * compress_st.
+ */
+struct bitstream_st;
+struct stats_st;
+struct compress_params_st
+{
+	struct bitstream_st *ibs, *obs;
+	unsigned level, nthreads, sort_threads;
+	int member_trailer, block_crcs;
+	struct stats_st *stats;
+	int block_stats;
+};
+
+/* What decompress() is to do: decompress `ibs' into `obs', adding
+ * the blocks to the index being made if `index_blocks', and with
+ * the stages in threads of their own if `pipeline'.  `stats' and
+ * `block_stats' are like compress()'s. */
+struct decompress_params_st
+{
+	struct bitstream_st *ibs, *obs;
+	int index_blocks, pipeline;
+	struct stats_st *stats;
+	int block_stats;
 };
 
 /* Function ptototypes */
@@ -48,13 +104,50 @@ extern void panic(char const *fmt, ...)
 	__attribute__ ((noreturn));
 extern void throw_exception(int errorcode)
 	__attribute__ ((noreturn));
+extern jmp_buf *catch_exceptions(jmp_buf *handler);
 extern void lc_recallocp(void *ptrp, size_t newsize);
+extern void lc_hugeallocp(void *ptrp, size_t newsize, char const *what);
+extern void lc_hugefree(void *ptrp);
+extern void lc_put_be(u_int8_t *buf, u_int64_t n, unsigned size);
+extern u_int64_t lc_get_be(u_int8_t const *buf, unsigned size);
 
-extern int start_threads(int (*tcomp)[2], unsigned nthreads);
 extern void stop_threads(void);
+extern void crc_init_once(void);
+
+extern int bzip_buffer(void *out, size_t *outsizep,
+	void const *in, size_t insize, unsigned level);
+extern int bunzip_buffer(void *out, size_t *outsizep,
+	void const *in, size_t insize);
+
+struct compress_st;
+extern struct compress_st *compress_new(
+	struct compress_params_st const *params);
+extern void compress(struct compress_st *cx);
+extern void compress_start(struct compress_st *cx);
+extern int compress_block(struct compress_st *cx);
+extern void compress_finish(struct compress_st *cx);
+extern void compress_abort(struct compress_st *cx);
+extern void compress_free(struct compress_st *cx);
 
-extern void compress(void);
-extern void decompress(void);
+struct member_st;
+struct index_entry_st;
+struct decompress_st;
+extern struct decompress_st *decompress_new(
+	struct decompress_params_st const *params);
+extern int decompress(struct decompress_st *dx, struct member_st *member);
+extern int decompress_start(struct decompress_st *dx,
+	struct member_st *member);
+extern int decompress_block(struct decompress_st *dx);
+extern void decompress_finish(struct decompress_st *dx);
+extern void decompress_tell(struct decompress_st const *dx,
+	struct index_entry_st *entry);
+extern void decompress_seek(struct decompress_st *dx,
+	struct index_entry_st const *entry);
+extern void decompress_range(struct decompress_st *dx,
+	struct index_entry_st const *entries, unsigned nentries,
+	off_t from, off_t length);
+extern void decompress_abort(struct decompress_st *dx);
+extern void decompress_free(struct decompress_st *dx);
 
 /* Global variables */
 extern struct main_runtime_st main_runtime;
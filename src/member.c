@@ -0,0 +1,175 @@
+/*
+ * member.c -- member trailers and the member directory
+ *
+ * Members compressed with -M have MEMBER_VERSION for the third byte
+ * of their magic, and after their CRC and the alignment they have
+ * a trailer:
+ *
+ *	usize	8 bytes	size of the uncompressed data
+ *	crc	4 bytes	its CRC, the same as the one in the stream
+ *	csize	8 bytes	size of the whole member, trailer included
+ *	magic	4 bytes	MEMBER_TRAILER_MAGIC
+ *
+ * Members of MEMBER_VERSION_SIZED also have the usize right after
+ * their magic, so the decompressor knows in advance how much it will
+ * write.  We only know it when compressing regular files.
+ *
+ * Members compressed with -e have MEMBER_VERSION_BLOCK_CRC added
+ * to their version, and the stream has the CRC of every block right
+ * after the block, so damage can be found before the end.
+ *
+ * Numbers are big-endian.  The trailer is at the very end of the
+ * member and tells where the member begins, so the members of a
+ * regular file can be found from its end with a look at each.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <string.h>
+
+#include "main.h"
+#include "bitstream.h"
+#include "member.h"
+#include "lc_common.h"
+
+/* Standard definitions */
+#define MEMBER_TRAILER_MAGIC		"BZ1E"
+
+/* Program code */
+/* Interface functions */
+/* Writes the header after the magic, which ends on a byte boundary. */
+void member_put_header(struct bitstream_st *bs, off_t usize)
+{
+	u_int8_t header[MEMBER_HEADER_SIZE];
+
+	lc_put_be(header, usize, sizeof(header));
+	bs_put_bytes(bs, header, sizeof(header));
+} /* member_put_header */
+
+off_t member_get_header(struct bitstream_st *bs)
+{
+	off_t usize;
+	u_int8_t header[MEMBER_HEADER_SIZE];
+
+	bs_get_bytes(bs, header, sizeof(header));
+	if ((usize = lc_get_be(header, sizeof(header))) < 0)
+	{
+		logf("%s: invalid member header", bs->fname);
+		throw_exception(EXIT_ERR_INPUT);
+	}
+
+	return usize;
+} /* member_get_header */
+
+/* Appends the trailer of `member' to `bs', which should be aligned. */
+void member_put_trailer(struct bitstream_st *bs,
+	struct member_st const *member)
+{
+	u_int8_t trailer[MEMBER_TRAILER_SIZE];
+
+	lc_put_be(&trailer[0], member->usize, 8);
+	lc_put_be(&trailer[8], member->crc, 4);
+	lc_put_be(&trailer[12], member->csize, 8);
+	memcpy(&trailer[20], STR_LEN(MEMBER_TRAILER_MAGIC));
+	bs_put_bytes(bs, trailer, sizeof(trailer));
+} /* member_put_trailer */
+
+/* Reads the trailer following the member just decompressed from
+ * `bs' and makes sure it agrees with what we've seen. */
+void member_check_trailer(struct bitstream_st *bs,
+	struct member_st const *member)
+{
+	u_int8_t trailer[MEMBER_TRAILER_SIZE];
+
+	bs_get_bytes(bs, trailer, sizeof(trailer));
+	if (memcmp(&trailer[20], STR_LEN(MEMBER_TRAILER_MAGIC))
+		|| lc_get_be(&trailer[0], 8) != member->usize
+		|| lc_get_be(&trailer[8], 4) != member->crc
+		|| lc_get_be(&trailer[12], 8) != member->csize)
+	{
+		logf("%s: invalid member trailer", bs->fname);
+		throw_exception(EXIT_ERR_INPUT);
+	}
+} /* member_check_trailer */
+
+/*
+ * Returns the members of `bs' in order and their number in *nmembersp,
+ * or NULL if they can't be found without decoding them: if `bs' is not
+ * a regular file or some of its members have no trailer.  The members
+ * are not verified; that's done when they are decompressed.  The caller
+ * should free() the directory.
+ */
+struct member_st *member_directory(struct bitstream_st const *bs,
+	unsigned *nmembersp)
+{
+	off_t end;
+	unsigned i, n, size;
+	struct member_st *members;
+
+	if (!bs->map)
+		return NULL;
+
+	n = size = 0;
+	members = NULL;
+	for (end = bs->map_size; end > 0; end = members[n - 1].offset)
+	{
+		off_t csize;
+		struct member_st *member;
+		u_int8_t const *trailer, *magic;
+
+		if (end < MEMBER_TRAILER_SIZE)
+			goto out;
+		trailer = &bs->map[end - MEMBER_TRAILER_SIZE];
+		if (memcmp(&trailer[20], STR_LEN(MEMBER_TRAILER_MAGIC)))
+			goto out;
+
+		/* Make sure we're looking at a member. */
+		csize = lc_get_be(&trailer[12], 8);
+		if (!INRANGE(csize, 4 + MEMBER_TRAILER_SIZE, end))
+			goto out;
+		magic = &bs->map[end - csize];
+		if (magic[0] != 'B' || magic[1] != 'Z'
+				|| !INRANGE(magic[2], MEMBER_VERSION,
+					MEMBER_VERSION_SIZED
+						+ MEMBER_VERSION_BLOCK_CRC)
+				|| magic[3] <= '0')
+			goto out;
+
+		if (n == size)
+		{
+			size = size ? size * 2 : 16;
+			if (!(member = realloc(members,
+				size * sizeof(*members))))
+			{
+				logf("realloc: %s", strerror(errno));
+				free(members);
+				throw_exception(EXIT_ERR_OTHER);
+			}
+			members = member;
+		}
+
+		member = &members[n++];
+		member->offset = end - csize;
+		member->csize = csize;
+		member->usize = lc_get_be(&trailer[0], 8);
+		member->crc = lc_get_be(&trailer[8], 4);
+		member->level = magic[3] - '0';
+	} /* for */
+
+	/* We've found them backwards. */
+	for (i = 0; i < n / 2; i++)
+		XCHG_ANY(members[i], members[n - 1 - i]);
+
+	*nmembersp = n;
+	return members;
+
+out:
+	free(members);
+	return NULL;
+} /* member_directory */
+
+/* End of member.c */
@@ -0,0 +1,41 @@
+/* member.h */
+#ifndef MEMBER_H
+#define MEMBER_H
+
+/* Include files */
+#include "config.h"
+
+#include <sys/types.h>
+
+#include "bitstream.h"
+
+/* Standard definitions */
+/* The third byte of the magic of members followed by a trailer,
+ * and of those which also have their uncompressed size up front */
+#define MEMBER_VERSION			'1'
+#define MEMBER_VERSION_SIZED		'2'
+/* Added to either of them if each block is followed by its CRC */
+#define MEMBER_VERSION_BLOCK_CRC	2
+#define MEMBER_HEADER_SIZE		8
+#define MEMBER_TRAILER_SIZE		(8 + 4 + 8 + 4)
+
+/* Type definitions */
+/* Where a member is in the file and what its trailer says. */
+struct member_st
+{
+	off_t offset, csize, usize;
+	u_int32_t crc;
+	unsigned level;
+};
+
+/* Function prototypes */
+extern void member_put_header(struct bitstream_st *bs, off_t usize);
+extern off_t member_get_header(struct bitstream_st *bs);
+extern void member_put_trailer(struct bitstream_st *bs,
+	struct member_st const *member);
+extern void member_check_trailer(struct bitstream_st *bs,
+	struct member_st const *member);
+extern struct member_st *member_directory(struct bitstream_st const *bs,
+	unsigned *nmembersp);
+
+#endif /* ! MEMBER_H */
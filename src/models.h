@@ -58,32 +58,36 @@ enum
  */
 struct Model
 {
-	unsigned const numSymbols, incValue, noExceed;
+	unsigned numSymbols, incValue, noExceed;
 	unsigned totFreq, freq[MAX_SYMBOLS];
 };
 
+/* The models of a coder: the bogus one for numbers and the structured
+ * model proper.  Each coder has its own. */
+struct models_st
+{
+	struct Model bogus, m[MODEL_LAST];
+};
+
+/* `model' is the index of the model in models_st.m */
 struct MTFVals_encode_st
 {
-	unsigned v;
-	struct Model *m;
-	unsigned n;
+	unsigned v, model, n;
 };
 
 struct MTFVals_decode_st
 {
-	struct Model *m;
-	unsigned n;
+	unsigned model, n;
 };
 
 /* Function prototypes */
-extern void initModels(void);
-extern void initBogusModel(void);
+extern void initModels(struct models_st *models);
+extern void initBogusModel(struct models_st *models);
 
 static inline void scaleModel(struct Model *m);
 static inline void updateModel(struct Model *m, unsigned symbol);
 
 /* Global variables */
-extern struct Model model_bogus, models[];
 extern struct MTFVals_encode_st const MTFVals_encode[];
 extern struct MTFVals_decode_st const MTFVals_decode[];
 
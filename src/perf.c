@@ -0,0 +1,101 @@
+/*
+ * perf.c -- hardware performance counters for -v
+ *
+ * With -v the stages are counted as well as timed: how many cycles
+ * and instructions they took and how many cache and branch misses
+ * they had.  The counters are opened by perf_event_open(2) for the
+ * thread running a stage when it starts and read and closed when it
+ * ends, so a stage is counted on its own even if the other stages
+ * run in other threads at the same time.  That's a few system calls
+ * a block, nothing compared to the block.  Only user space is counted,
+ * so what the kernel does for the I/O of a stage is not included,
+ * nor the waiting.
+ *
+ * The counters the kernel doesn't have, or doesn't let us have,
+ * are said once and not tried again.  They are left zero.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "main.h"
+#include "perf.h"
+#include "lc_common.h"
+
+/* Private variables */
+static unsigned const perf_configs[PERF_LAST] =
+{
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/* The counters which couldn't be opened.  The threads may race
+ * on them, but at worst the failure is said more than once. */
+static int refused[PERF_LAST];
+
+/* Program code */
+/* Interface functions */
+char const *const perf_names[PERF_LAST] =
+{
+	"cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+void perf_start(struct perf_st *perf)
+{
+	unsigned i;
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	for (i = 0; i < PERF_LAST; i++)
+	{
+		perf->fds[i] = -1;
+		if (refused[i])
+			continue;
+
+		attr.config = perf_configs[i];
+		perf->fds[i] = syscall(__NR_perf_event_open, &attr,
+			0, -1, -1, 0);
+		if (perf->fds[i] < 0)
+		{
+			logf("perf_event_open: %s: %s; not counted",
+				perf_names[i], strerror(errno));
+			refused[i] = 1;
+		}
+	}
+} /* perf_start */
+
+/* Adds what has been counted since perf_start() to `counts'. */
+void perf_stop(struct perf_st *perf, unsigned long long *counts)
+{
+	unsigned i;
+
+	for (i = 0; i < PERF_LAST; i++)
+	{
+		u_int64_t count;
+
+		if (perf->fds[i] < 0)
+			continue;
+		if (read(perf->fds[i], &count, sizeof(count))
+				== sizeof(count))
+			counts[i] += count;
+		close(perf->fds[i]);
+	}
+} /* perf_stop */
+
+/* End of perf.c */
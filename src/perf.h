@@ -0,0 +1,38 @@
+/* perf.h */
+#ifndef PERF_H
+#define PERF_H
+
+/* Include files */
+#include "config.h"
+
+/* Standard definitions */
+/* The events counted */
+enum
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+
+	PERF_LAST
+};
+
+/* Type definitions */
+/* The counters of a stage being counted, in the calling thread */
+struct perf_st
+{
+	int fds[PERF_LAST];
+};
+
+/* Function prototypes */
+#ifdef CONFIG_PERF_COUNTERS
+extern char const *const perf_names[PERF_LAST];
+
+extern void perf_start(struct perf_st *perf);
+extern void perf_stop(struct perf_st *perf, unsigned long long *counts);
+#else /* ! CONFIG_PERF_COUNTERS */
+# define perf_start(perf)		((void)(perf))
+# define perf_stop(perf, counts)	((void)(perf))
+#endif
+
+#endif /* ! PERF_H */
@@ -0,0 +1,240 @@
+/*
+ * stats.c -- where the time goes, for -v
+ *
+ * The compressor and the decompressor time their stages on every
+ * block and add them up for the file; we print them.  Either as
+ * a line of text for people or, with -J, as one JSON object per line
+ * for the scripts collecting them.  File lines are like block lines,
+ * only without "block" and with the "wall" time.  What perf.c has
+ * counted follows on lines of its own, or in the "perf" of the object.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "main.h"
+#include "stats.h"
+#include "lc_common.h"
+
+/* Private variables */
+static char const *const stage_names[STATS_LAST] =
+{
+	"rle", "sort", "code",
+	"decode", "invert", "dump",
+	"read", "write"
+};
+
+/* Function prototypes */
+static int stage_shown(unsigned stage);
+static void json_string(FILE *fp, char const *str);
+#ifdef CONFIG_PERF_COUNTERS
+static int stage_counted(struct stats_st const *stats, unsigned stage);
+static void report_counts(char const *fname, unsigned block,
+	struct stats_st const *stats);
+#endif
+
+/* Program code */
+/* Interface functions */
+double stats_now(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec / 1e6;
+} /* stats_now */
+
+void stats_add(struct stats_st *to, struct stats_st const *from)
+{
+	unsigned i;
+
+	for (i = 0; i < STATS_LAST; i++)
+	{
+#ifdef CONFIG_PERF_COUNTERS
+		unsigned j;
+
+		for (j = 0; j < PERF_LAST; j++)
+			to->counts[i][j] += from->counts[i][j];
+#endif
+		to->secs[i] += from->secs[i];
+	}
+	to->in += from->in;
+	to->out += from->out;
+	to->fullgts += from->fullgts;
+	to->blocks += from->blocks;
+} /* stats_add */
+
+/* Reports the `block'th block of `fname', or the whole file
+ * if it's 0, which took `wall' seconds. */
+void stats_report(char const *fname, unsigned block,
+	struct stats_st const *stats, double wall)
+{
+	unsigned i;
+
+	if (main_runtime.stats_json)
+	{
+		fputs("{\"file\":", stderr);
+		json_string(stderr, fname);
+		if (block)
+			fprintf(stderr, ",\"block\":%u", block);
+		else
+			fprintf(stderr, ",\"blocks\":%u,\"wall\":%.6f",
+				stats->blocks, wall);
+		fprintf(stderr, ",\"in\":%lld,\"out\":%lld",
+			(long long)stats->in, (long long)stats->out);
+		for (i = 0; i < STATS_LAST; i++)
+			if (stage_shown(i))
+				fprintf(stderr, ",\"%s\":%.6f",
+					stage_names[i], stats->secs[i]);
+		if (IS_COMPRESS())
+			fprintf(stderr, ",\"fullgt\":%llu", stats->fullgts);
+#ifdef CONFIG_PERF_COUNTERS
+		report_counts(NULL, block, stats);
+#endif
+		fputs("}\n", stderr);
+	} else
+	{
+		off_t usize;
+		size_t n;
+		char const *sep;
+		char line[256];
+
+		n = 0;
+		if (block)
+			n += snprintf(&line[n], sizeof(line) - n,
+				"block %u: ", block);
+		n += snprintf(&line[n], sizeof(line) - n, "%lld -> %lld bytes",
+			(long long)stats->in, (long long)stats->out);
+		if (!block)
+		{	/* Throughput is of the uncompressed data. */
+			usize = IS_COMPRESS() ? stats->in : stats->out;
+			n += snprintf(&line[n], sizeof(line) - n,
+				" in %u blocks, %.2fs, %.1f MB/s",
+				stats->blocks, wall, wall > 0
+					? usize / wall / (1024 * 1024)
+					: 0.0);
+		}
+
+		sep = ";";
+		for (i = 0; i < STATS_LAST; i++)
+			if (stage_shown(i))
+			{
+				n += snprintf(&line[n], sizeof(line) - n,
+					"%s %s %.3fs", sep, stage_names[i],
+					stats->secs[i]);
+				if (i == STATS_SORT)
+					n += snprintf(&line[n],
+						sizeof(line) - n,
+						" (%llu comparisons)",
+						stats->fullgts);
+				sep = ",";
+			}
+		logf("%s: %s", fname, line);
+#ifdef CONFIG_PERF_COUNTERS
+		report_counts(fname, block, stats);
+#endif
+	}
+} /* stats_report */
+
+/* Private functions */
+/* Only the stages of what we're doing are of interest, and the I/O. */
+int stage_shown(unsigned stage)
+{
+	if (stage >= STATS_READ)
+		return 1;
+	return IS_COMPRESS() ? stage < STATS_DECODE : stage >= STATS_DECODE;
+} /* stage_shown */
+
+void json_string(FILE *fp, char const *str)
+{
+	fputc('"', fp);
+	for (; *str; str++)
+		if (*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if ((unsigned char)*str < ' ')
+			fprintf(fp, "\\u%04x", (unsigned char)*str);
+		else
+			fputc(*str, fp);
+	fputc('"', fp);
+} /* json_string */
+
+#ifdef CONFIG_PERF_COUNTERS
+/* Whether anything was counted in `stage'; not if the counters
+ * were refused. */
+int stage_counted(struct stats_st const *stats, unsigned stage)
+{
+	unsigned i;
+
+	if (stage >= STATS_READ || !stage_shown(stage))
+		return 0;
+	for (i = 0; i < PERF_LAST; i++)
+		if (stats->counts[stage][i])
+			return 1;
+	return 0;
+} /* stage_counted */
+
+/*
+ * Reports the counts of the stages of `stats' as a line each, with
+ * the counts per MB of uncompressed data, or as a "perf" object of
+ * the JSON object being printed if `fname' is NULL.
+ */
+void report_counts(char const *fname, unsigned block,
+	struct stats_st const *stats)
+{
+	unsigned i, j;
+	double mbs;
+	char const *sep;
+
+	mbs = (IS_COMPRESS() ? stats->in : stats->out) / (1024.0 * 1024);
+	sep = "";
+	for (i = 0; i < STATS_LAST; i++)
+	{
+		size_t n;
+		char line[256];
+
+		if (!stage_counted(stats, i))
+			continue;
+
+		if (!fname)
+		{
+			fprintf(stderr, "%s\"%s\":{",
+				*sep ? sep : ",\"perf\":{", stage_names[i]);
+			for (j = 0; j < PERF_LAST; j++)
+				fprintf(stderr, "%s\"%s\":%llu", j ? "," : "",
+					perf_names[j], stats->counts[i][j]);
+			fputc('}', stderr);
+			sep = ",";
+			continue;
+		}
+
+		n = 0;
+		if (block)
+			n += snprintf(&line[n], sizeof(line) - n,
+				"block %u: ", block);
+		n += snprintf(&line[n], sizeof(line) - n, "%s:",
+			stage_names[i]);
+		for (j = 0; j < PERF_LAST; j++)
+			n += snprintf(&line[n], sizeof(line) - n, "%s %llu %s",
+				j ? "," : "", stats->counts[i][j],
+				perf_names[j]);
+		if (mbs > 0)
+		{
+			n += snprintf(&line[n], sizeof(line) - n, "; per MB");
+			for (j = 0; j < PERF_LAST; j++)
+				n += snprintf(&line[n], sizeof(line) - n,
+					"%s %.0f", j ? "," : "",
+					stats->counts[i][j] / mbs);
+		}
+		logf("%s: %s", fname, line);
+	}
+	if (*sep)
+		fputc('}', stderr);
+} /* report_counts */
+#endif /* CONFIG_PERF_COUNTERS */
+
+/* End of stats.c */
@@ -0,0 +1,60 @@
+/* stats.h */
+#ifndef STATS_H
+#define STATS_H
+
+/* Include files */
+#include "config.h"
+
+#include <sys/types.h>
+
+#include "perf.h"
+
+/* Standard definitions */
+/* The stages of compression, then those of decompression, then I/O */
+enum
+{
+	STATS_RLE,
+	STATS_SORT,
+	STATS_CODE,
+
+	STATS_DECODE,
+	STATS_INVERT,
+	STATS_DUMP,
+
+	STATS_READ,
+	STATS_WRITE,
+
+	STATS_LAST
+};
+
+/* Type definitions */
+/*
+ * How long the stages took on a block or a file, in seconds, how
+ * many bytes the blocks had before and after, the headers and the
+ * trailers of the members counted too for a file, and how many times
+ * the sorter compared suffixes with fullGt().  With the counters
+ * compiled in, `counts' are what perf.c has counted in each stage.
+ * The time a stage waited for its input or output is not its own
+ * but counted in STATS_READ and STATS_WRITE.  These are wall times: with threads
+ * the stages overlap, so they may add up to more than the wall time
+ * of the file, and with fewer processors than threads a stage also
+ * counts the time the others ran.
+ */
+struct stats_st
+{
+	double secs[STATS_LAST];
+	off_t in, out;
+	unsigned long long fullgts;
+	unsigned blocks;
+#ifdef CONFIG_PERF_COUNTERS
+	unsigned long long counts[STATS_LAST][PERF_LAST];
+#endif
+};
+
+/* Function prototypes */
+extern double stats_now(void);
+extern void stats_add(struct stats_st *to, struct stats_st const *from);
+extern void stats_report(char const *fname, unsigned block,
+	struct stats_st const *stats, double wall);
+
+#endif /* ! STATS_H */
@@ -0,0 +1,382 @@
+/*
+ * stream.c -- compressing and decompressing a piece at a time
+ *
+ * A stream is driven by bzip_stream_pull(), which takes the next step
+ * of the compressor or the decompressor whenever the output it has
+ * is taken: the header of a member, a block, or its end.  The steps
+ * read their input from a memory bitstream, which throws BS_NEED_INPUT
+ * rather than reading beyond what has been pushed.  Before a block
+ * the state of the coder is just where it is in the input (and the
+ * state of the arithmetic decoder, see decompress_tell()), so if that
+ * happens we go back there and try again when the caller has pushed
+ * enough more.  Half-done steps don't write anything.
+ *
+ * The input of a step is kept until it's done, and it's not tried
+ * again before its input has doubled, so that it's read at most
+ * about twice however little the caller pushes at a time.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <setjmp.h>
+#include <string.h>
+
+#include "main.h"
+#include "stream.h"
+#include "bitstream.h"
+#include "member.h"
+#include "index.h"
+#include "lc_common.h"
+
+/* Standard definitions */
+enum
+{
+	/* Compression */
+	STREAM_COMPRESS_START,
+	STREAM_COMPRESS_BLOCK,
+	STREAM_COMPRESS_FINISH,
+
+	/* Decompression */
+	STREAM_DECOMPRESS_MAGIC,
+	STREAM_DECOMPRESS_BLOCK,
+	STREAM_DECOMPRESS_FINISH,
+
+	STREAM_DONE
+};
+
+/* Type definitions */
+/*
+ * `mark' is where the step being taken started.  `want' is how much
+ * input it should have before it's tried again, and `error' is what
+ * has gone wrong, which is returned by every call from then on.
+ * `start' is where the member being coded starts in the output if
+ * we're compressing, in the input otherwise, `ustart' is where its
+ * data starts in the output, and `member' is what we know of it.
+ */
+struct bzip_stream_st
+{
+	struct bitstream_st ibs, obs;
+	struct compress_st *cx;
+	struct decompress_st *dx;
+
+	int state, error;
+	struct index_entry_st mark;
+	size_t want;
+
+	int trailer;
+	unsigned nmembers;
+	off_t start, ustart;
+	struct member_st member;
+};
+
+/* Function prototypes */
+static int stream_new(struct bzip_stream_st **streamp,
+	struct bzip_stream_st *stream);
+static int stream_step(struct bzip_stream_st *stream);
+static void compress_step(struct bzip_stream_st *stream);
+static void decompress_step(struct bzip_stream_st *stream);
+
+/* Program code */
+/* Interface functions */
+/* Makes *streamp a stream compressing at `level'.  Returns 0 or
+ * the exit code of the error, which has been logged. */
+int bzip_stream_new(struct bzip_stream_st **streamp, unsigned level)
+{
+#ifdef CONFIG_COMPRESS
+	struct bzip_stream_st *stream;
+
+	if (!(stream = calloc(1, sizeof(*stream))))
+		return stream_new(streamp, NULL);
+
+	bs_open_stream(&stream->ibs, 0);
+	bs_open_stream(&stream->obs, 1);
+	stream->state = STREAM_COMPRESS_START;
+	stream->member.level = level;
+	return stream_new(streamp, stream);
+#else /* ! CONFIG_COMPRESS */
+	return EXIT_ERR_OTHER;
+#endif
+} /* bzip_stream_new */
+
+/* Makes *streamp a stream decompressing as many members
+ * as are pushed. */
+int bunzip_stream_new(struct bzip_stream_st **streamp)
+{
+#ifdef CONFIG_DECOMPRESS
+	struct bzip_stream_st *stream;
+
+	if (!(stream = calloc(1, sizeof(*stream))))
+		return stream_new(streamp, NULL);
+
+	bs_open_stream(&stream->ibs, 0);
+	bs_open_stream(&stream->obs, 1);
+	stream->state = STREAM_DECOMPRESS_MAGIC;
+	return stream_new(streamp, stream);
+#else /* ! CONFIG_DECOMPRESS */
+	return EXIT_ERR_OTHER;
+#endif
+} /* bunzip_stream_new */
+
+/* Adds `size' bytes to the input of `stream'.  Pushing nothing
+ * says there won't be more. */
+int bzip_stream_push(struct bzip_stream_st *stream,
+	void const *buf, size_t size)
+{
+	jmp_buf handler, *prev;
+
+	if (stream->error)
+		return stream->error;
+	if (stream->ibs.eof && size)
+	{
+		logf("%s: pushed beyond the end", stream->ibs.fname);
+		return stream->error = EXIT_ERR_USER;
+	}
+
+	prev = catch_exceptions(&handler);
+	if ((stream->error = setjmp(handler)) == 0)
+		bs_stream_push(&stream->ibs, buf, size);
+	catch_exceptions(prev);
+
+	return stream->error;
+} /* bzip_stream_push */
+
+/*
+ * Takes at most *sizep bytes of the output of `stream' to `buf' and
+ * says in *sizep how many there were.  Returns 0 if there were any,
+ * BZIP_STREAM_NEED_INPUT if there won't be until more is pushed,
+ * BZIP_STREAM_END if all the output has been taken, or the exit code
+ * of the error, which has been logged.
+ */
+int bzip_stream_pull(struct bzip_stream_st *stream, void *buf, size_t *sizep)
+{
+	size_t size;
+
+	size = *sizep;
+	*sizep = 0;
+	while (!stream->error)
+	{
+		int error;
+		size_t have;
+
+		if ((*sizep = bs_stream_pull(&stream->obs, buf, size)) > 0)
+			return 0;
+		if (stream->state == STREAM_DONE)
+			return BZIP_STREAM_END;
+
+		/* What's before the mark we won't go back to. */
+		bs_stream_mark(&stream->ibs);
+		have = stream->ibs.byte_end - stream->ibs.byte_window;
+		if (!stream->ibs.eof && have < stream->want)
+			return BZIP_STREAM_NEED_INPUT;
+
+		if ((error = stream_step(stream)) == BS_NEED_INPUT)
+		{	/* Try again when there's twice as much. */
+#ifdef CONFIG_DECOMPRESS
+			if (stream->dx)
+				decompress_seek(stream->dx, &stream->mark);
+			else
+#endif
+				bs_seek_bit(&stream->ibs, stream->mark.cbit);
+			stream->want = MAX(have * 2, BS_WINDOW_SIZE);
+		} else
+		{
+			stream->error = error;
+			stream->want = 0;
+		}
+	} /* while */
+
+	return stream->error;
+} /* bzip_stream_pull */
+
+void bzip_stream_free(struct bzip_stream_st *stream)
+{
+#ifdef CONFIG_COMPRESS
+	if (stream->cx)
+		compress_free(stream->cx);
+#endif
+#ifdef CONFIG_DECOMPRESS
+	if (stream->dx)
+		decompress_free(stream->dx);
+#endif
+	free(stream->ibs.byte_buf);
+	free(stream->obs.byte_buf);
+	free(stream);
+} /* bzip_stream_free */
+
+/* Private functions */
+/* Gives `stream' its coder and returns it in *streamp,
+ * or frees it if that fails. */
+int stream_new(struct bzip_stream_st **streamp,
+	struct bzip_stream_st *stream)
+{
+	int error;
+	jmp_buf handler, *prev;
+
+	if (!stream)
+	{
+		logf("calloc: out of memory");
+		return EXIT_ERR_OTHER;
+	}
+
+	crc_init_once();
+	prev = catch_exceptions(&handler);
+	if ((error = setjmp(handler)) == 0)
+	{
+#ifdef CONFIG_COMPRESS
+		if (stream->state == STREAM_COMPRESS_START)
+		{
+			struct compress_params_st params;
+
+			memset(&params, 0, sizeof(params));
+			params.ibs = &stream->ibs;
+			params.obs = &stream->obs;
+			params.level = stream->member.level;
+			params.member_trailer = 1;
+			stream->cx = compress_new(&params);
+		}
+#endif
+#ifdef CONFIG_DECOMPRESS
+		if (stream->state == STREAM_DECOMPRESS_MAGIC)
+		{
+			struct decompress_params_st params;
+
+			params.ibs = &stream->ibs;
+			params.obs = &stream->obs;
+			params.index_blocks = params.pipeline = 0;
+			params.stats = NULL;
+			params.block_stats = 0;
+			stream->dx = decompress_new(&params);
+		}
+#endif
+	}
+	catch_exceptions(prev);
+
+	if (error)
+	{
+		bzip_stream_free(stream);
+		return error;
+	}
+
+	*streamp = stream;
+	return 0;
+} /* stream_new */
+
+/* Takes the next step of `stream' in the calling thread.  Returns 0,
+ * BS_NEED_INPUT or the exit code of the error. */
+int stream_step(struct bzip_stream_st *stream)
+{
+	int error;
+	jmp_buf handler, *prev;
+
+	prev = catch_exceptions(&handler);
+	if ((error = setjmp(handler)) == 0)
+	{
+		if (stream->cx)
+			compress_step(stream);
+		else
+			decompress_step(stream);
+	}
+	catch_exceptions(prev);
+
+	return error;
+} /* stream_step */
+
+void compress_step(struct bzip_stream_st *stream)
+{
+#ifdef CONFIG_COMPRESS
+	struct bitstream_st *ibs, *obs;
+
+	ibs = &stream->ibs;
+	obs = &stream->obs;
+	stream->mark.cbit = bs_tell_bit(ibs);
+	switch (stream->state)
+	{
+	case STREAM_COMPRESS_START:
+		stream->start = bs_output_size(obs);
+		ibs->crc = ~0;
+		compress_start(stream->cx);
+		stream->state = STREAM_COMPRESS_BLOCK;
+		break;
+	case STREAM_COMPRESS_BLOCK:
+		if (compress_block(stream->cx))
+			stream->state = STREAM_COMPRESS_FINISH;
+		break;
+	case STREAM_COMPRESS_FINISH:
+		/* Like bzip_member(). */
+		compress_finish(stream->cx);
+		bs_align(obs);
+		stream->member.usize = ibs->nread;
+		stream->member.crc = ~ibs->crc;
+		stream->member.csize = bs_output_size(obs)
+			- stream->start + MEMBER_TRAILER_SIZE;
+		member_put_trailer(obs, &stream->member);
+		bs_flush_bit(obs);
+		stream->state = STREAM_DONE;
+		break;
+	}
+#endif /* CONFIG_COMPRESS */
+} /* compress_step */
+
+void decompress_step(struct bzip_stream_st *stream)
+{
+#ifdef CONFIG_DECOMPRESS
+	struct bitstream_st *ibs, *obs;
+	struct member_st *member;
+
+	ibs = &stream->ibs;
+	obs = &stream->obs;
+	member = &stream->member;
+	decompress_tell(stream->dx, &stream->mark);
+	switch (stream->state)
+	{
+	case STREAM_DECOMPRESS_MAGIC:
+		if (stream->nmembers > 0 && ibs->bit_p == ibs->bit_end
+			&& ibs->byte_p == ibs->byte_end)
+		{	/* Another member or the end? */
+			if (!ibs->eof)
+				throw_exception(BS_NEED_INPUT);
+			stream->state = STREAM_DONE;
+			break;
+		}
+
+		stream->start = bs_tell_bit(ibs);
+		stream->ustart = bs_output_size(obs);
+		obs->crc = ~0;
+		stream->trailer = decompress_start(stream->dx, member);
+		stream->state = STREAM_DECOMPRESS_BLOCK;
+		break;
+	case STREAM_DECOMPRESS_BLOCK:
+		if (decompress_block(stream->dx))
+			stream->state = STREAM_DECOMPRESS_FINISH;
+		break;
+	case STREAM_DECOMPRESS_FINISH:
+		/* Like bunzip_member(). */
+		decompress_finish(stream->dx);
+		bs_align(ibs);
+		if (member->usize >= 0 && member->usize
+			!= bs_output_size(obs) - stream->ustart)
+		{
+			logf("%s: invalid member header", ibs->fname);
+			throw_exception(EXIT_ERR_INPUT);
+		}
+
+		if (stream->trailer)
+		{
+			member->csize = (bs_tell_bit(ibs) - stream->start)
+				/ BITS_OF(u_int8_t) + MEMBER_TRAILER_SIZE;
+			member->usize = bs_output_size(obs)
+				- stream->ustart;
+			member->crc = ~obs->crc;
+			member_check_trailer(ibs, member);
+		}
+		stream->nmembers++;
+		stream->state = STREAM_DECOMPRESS_MAGIC;
+		break;
+	}
+#endif /* CONFIG_DECOMPRESS */
+} /* decompress_step */
+
+/* End of stream.c */
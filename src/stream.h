@@ -0,0 +1,35 @@
+/* stream.h */
+#ifndef STREAM_H
+#define STREAM_H
+
+/* Include files */
+#include "config.h"
+
+#include <sys/types.h>
+
+/* Standard definitions */
+/* What bzip_stream_pull() returns besides 0 and the exit codes */
+#define BZIP_STREAM_NEED_INPUT		(-1)
+#define BZIP_STREAM_END			(-2)
+
+/* Type definitions */
+/*
+ * A compression or decompression which is given its input and has its
+ * output taken a piece at a time, by bzip_stream_push() and -pull().
+ * Nothing is written until a whole block has been read, so the output
+ * comes in bursts, and a block whose input runs out is started over
+ * when there's more.  The output of bzip streams is like bzip_buffer()'s
+ * and bunzip streams can read any members.
+ */
+struct bzip_stream_st;
+
+/* Function prototypes */
+extern int bzip_stream_new(struct bzip_stream_st **streamp, unsigned level);
+extern int bunzip_stream_new(struct bzip_stream_st **streamp);
+extern int bzip_stream_push(struct bzip_stream_st *stream,
+	void const *buf, size_t size);
+extern int bzip_stream_pull(struct bzip_stream_st *stream,
+	void *buf, size_t *sizep);
+extern void bzip_stream_free(struct bzip_stream_st *stream);
+
+#endif /* ! STREAM_H */
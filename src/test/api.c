@@ -0,0 +1,352 @@
+/*
+ * api.c -- tests of the library interface, run by make test
+ *
+ * Usage: api <file>...
+ *
+ * Compresses and decompresses each file with bzip_buffer() and
+ * bunzip_buffer(), asking them how big the output is first, then
+ * with too small a buffer and finally with one big enough, and with
+ * streams, pushing and pulling a few bytes at a time, and all that
+ * in several threads at once.  Says what went wrong and exits with 1
+ * if anything did.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <string.h>
+#include <stdio.h>
+#ifdef CONFIG_MULTITHREAD
+# include <pthread.h>
+#endif
+
+#include "main.h"
+#include "stream.h"
+#include "lc_common.h"
+
+/* Standard definitions */
+/* How many compressions run at once */
+#define NTHREADS			8
+
+/* How much is pushed into and pulled from a stream at a time; odd,
+ * so that the pieces don't line up with anything. */
+#define STREAM_PIECE			333
+
+/* Type definitions */
+struct file_st
+{
+	char const *fname;
+	u_int8_t *data;
+	size_t size;
+};
+
+/* Function prototypes */
+static int failed(char const *fname, char const *what, int error);
+static void read_file(struct file_st *file);
+static int test_roundtrip(struct file_st const *file, unsigned level);
+static int test_corrupt(struct file_st const *file);
+static int run_stream(struct bzip_stream_st *stream,
+	u_int8_t const *in, size_t insize, u_int8_t **outp, size_t *outsizep);
+static int test_stream(struct file_st const *file, unsigned level);
+#ifdef CONFIG_MULTITHREAD
+static void *roundtrip_thread(void *filep);
+static int test_concurrent(struct file_st const *file);
+#endif
+
+/* Program code */
+/* Private functions */
+int failed(char const *fname, char const *what, int error)
+{
+	fprintf(stderr, "api: %s: %s failed (%d)\n", fname, what, error);
+	return 1;
+} /* failed */
+
+void read_file(struct file_st *file)
+{
+	FILE *fp;
+	size_t size;
+
+	if (!(fp = fopen(file->fname, "rb")))
+	{
+		perror(file->fname);
+		exit(1);
+	}
+
+	file->size = 0;
+	file->data = NULL;
+	do
+	{
+		if (!(file->data = realloc(file->data, file->size + 65536)))
+		{
+			perror("realloc");
+			exit(1);
+		}
+		size = fread(&file->data[file->size], 1, 65536, fp);
+		file->size += size;
+	} while (size > 0);
+	fclose(fp);
+} /* read_file */
+
+/*
+ * Compresses `file' without a buffer to learn the size of the output,
+ * then into one a byte too small, which must say the same size, then
+ * into one just big enough.  Decompresses it the same way with a half
+ * big buffer and compares.  Returns whether it failed.
+ */
+int test_roundtrip(struct file_st const *file, unsigned level)
+{
+	int error;
+	size_t csize, usize, size;
+	u_int8_t *cbuf, *ubuf;
+
+	csize = 0;
+	if ((error = bzip_buffer(NULL, &csize, file->data, file->size,
+			level)) != 0)
+		return failed(file->fname, "sizing bzip_buffer", error);
+	if (!(cbuf = malloc(csize)))
+		return failed(file->fname, "malloc", 0);
+
+	size = csize - 1;
+	if ((error = bzip_buffer(cbuf, &size, file->data, file->size,
+			level)) != 0 || size != csize)
+	{
+		free(cbuf);
+		return failed(file->fname, "short bzip_buffer", error);
+	}
+
+	size = csize;
+	if ((error = bzip_buffer(cbuf, &size, file->data, file->size,
+			level)) != 0 || size != csize)
+	{
+		free(cbuf);
+		return failed(file->fname, "bzip_buffer", error);
+	}
+
+	usize = 0;
+	if ((error = bunzip_buffer(NULL, &usize, cbuf, csize)) != 0
+		|| usize != file->size)
+	{
+		free(cbuf);
+		return failed(file->fname, "sizing bunzip_buffer", error);
+	}
+	if (!(ubuf = malloc(usize + 1)))
+	{
+		free(cbuf);
+		return failed(file->fname, "malloc", 0);
+	}
+
+	size = usize / 2;
+	if ((error = bunzip_buffer(ubuf, &size, cbuf, csize)) != 0
+		|| size != usize)
+	{
+		free(cbuf);
+		free(ubuf);
+		return failed(file->fname, "short bunzip_buffer", error);
+	}
+
+	size = usize;
+	error = bunzip_buffer(ubuf, &size, cbuf, csize);
+	free(cbuf);
+	if (error)
+	{
+		free(ubuf);
+		return failed(file->fname, "bunzip_buffer", error);
+	}
+
+	error = size != file->size || memcmp(ubuf, file->data, size);
+	free(ubuf);
+	if (error)
+		return failed(file->fname, "round trip", 0);
+	return 0;
+} /* test_roundtrip */
+
+/* Flips a bit in the middle of the compressed `file', which
+ * bunzip_buffer() must notice. */
+int test_corrupt(struct file_st const *file)
+{
+	int error;
+	size_t csize, usize;
+	u_int8_t *cbuf, *ubuf;
+
+	csize = file->size + file->size / 2 + 1024;
+	usize = file->size;
+	cbuf = malloc(csize);
+	ubuf = malloc(usize + 1);
+	if (!cbuf || !ubuf)
+	{
+		free(cbuf);
+		free(ubuf);
+		return failed(file->fname, "malloc", 0);
+	}
+
+	if ((error = bzip_buffer(cbuf, &csize, file->data, file->size,
+			9)) == 0)
+	{
+		cbuf[csize / 2] ^= 0x10;
+		if (bunzip_buffer(ubuf, &usize, cbuf, csize)
+				!= EXIT_ERR_INPUT)
+			error = -1;
+	}
+	free(cbuf);
+	free(ubuf);
+
+	return error ? failed(file->fname, "detecting corruption", error)
+		: 0;
+} /* test_corrupt */
+
+/*
+ * Pushes `insize' bytes of `in' through `stream' STREAM_PIECE bytes
+ * at a time, pulling its output in pieces as big, until it ends.
+ * Returns the output in a malloc()ed *outp and its size in *outsizep,
+ * or the error of the stream.
+ */
+int run_stream(struct bzip_stream_st *stream,
+	u_int8_t const *in, size_t insize, u_int8_t **outp, size_t *outsizep)
+{
+	int error;
+	size_t pushed, alloced;
+
+	pushed = alloced = *outsizep = 0;
+	*outp = NULL;
+	for (;;)
+	{
+		size_t size;
+
+		if (*outsizep + STREAM_PIECE > alloced)
+		{
+			alloced = alloced * 2 + STREAM_PIECE;
+			if (!(*outp = realloc(*outp, alloced)))
+				return -1;
+		}
+
+		size = STREAM_PIECE;
+		error = bzip_stream_pull(stream, &(*outp)[*outsizep], &size);
+		if (!error)
+		{
+			*outsizep += size;
+			continue;
+		} else if (error == BZIP_STREAM_END)
+			return 0;
+		else if (error != BZIP_STREAM_NEED_INPUT)
+			return error;
+
+		/* Pushing nothing says the input is over. */
+		size = MIN(insize - pushed, STREAM_PIECE);
+		if ((error = bzip_stream_push(stream, &in[pushed], size)) != 0)
+			return error;
+		pushed += size;
+	} /* for */
+} /* run_stream */
+
+/* Compresses `file' with a stream, which bunzip_buffer() must read,
+ * decompresses it with another and compares. */
+int test_stream(struct file_st const *file, unsigned level)
+{
+	int error;
+	size_t csize, usize, size;
+	u_int8_t *cbuf, *ubuf;
+	struct bzip_stream_st *stream;
+
+	if ((error = bzip_stream_new(&stream, level)) != 0)
+		return failed(file->fname, "bzip_stream_new", error);
+	error = run_stream(stream, file->data, file->size, &cbuf, &csize);
+	bzip_stream_free(stream);
+	if (error)
+	{
+		free(cbuf);
+		return failed(file->fname, "compressing stream", error);
+	}
+
+	size = file->size;
+	if (!(ubuf = malloc(size + 1)))
+	{
+		free(cbuf);
+		return failed(file->fname, "malloc", 0);
+	}
+	error = bunzip_buffer(ubuf, &size, cbuf, csize);
+	if (!error && (size != file->size
+			|| memcmp(ubuf, file->data, size)))
+		error = -1;
+	free(ubuf);
+	if (error)
+	{
+		free(cbuf);
+		return failed(file->fname, "bunzip_buffer of stream", error);
+	}
+
+	if ((error = bunzip_stream_new(&stream)) != 0)
+	{
+		free(cbuf);
+		return failed(file->fname, "bunzip_stream_new", error);
+	}
+	error = run_stream(stream, cbuf, csize, &ubuf, &usize);
+	bzip_stream_free(stream);
+	free(cbuf);
+	if (!error && (usize != file->size
+			|| memcmp(ubuf, file->data, usize)))
+		error = -1;
+	free(ubuf);
+
+	return error ? failed(file->fname, "stream round trip", error) : 0;
+} /* test_stream */
+
+#ifdef CONFIG_MULTITHREAD
+void *roundtrip_thread(void *filep)
+{
+	return (void *)(long)(test_roundtrip(filep, 9)
+		| test_stream(filep, 9));
+} /* roundtrip_thread */
+
+/* Runs NTHREADS round trips at the same time, each with its
+ * own contexts and blocks. */
+int test_concurrent(struct file_st const *file)
+{
+	unsigned i, n;
+	int errors;
+	pthread_t threads[NTHREADS];
+
+	for (n = 0; n < NTHREADS; n++)
+		if (pthread_create(&threads[n], NULL, roundtrip_thread,
+				(void *)file) != 0)
+			break;
+
+	errors = n < NTHREADS;
+	for (i = 0; i < n; i++)
+	{
+		void *result;
+
+		pthread_join(threads[i], &result);
+		errors |= result != NULL;
+	}
+
+	return errors ? failed(file->fname, "concurrent round trips", 0) : 0;
+} /* test_concurrent */
+#endif /* CONFIG_MULTITHREAD */
+
+/* The main function */
+int main(int argc, char *argv[])
+{
+	int i, errors;
+
+	errors = 0;
+	for (i = 1; i < argc; i++)
+	{
+		struct file_st file;
+
+		file.fname = argv[i];
+		read_file(&file);
+		errors |= test_roundtrip(&file, 1);
+		errors |= test_corrupt(&file);
+		errors |= test_stream(&file, 1);
+#ifdef CONFIG_MULTITHREAD
+		errors |= test_concurrent(&file);
+#endif
+		free(file.data);
+	}
+
+	return errors;
+} /* main */
+
+/* End of api.c */
@@ -0,0 +1,81 @@
+#!/usr/bin/awk -f
+#
+# generate.awk -- reproducible test data
+#
+# Usage: awk -f generate.awk -v what=<what> -v size=<size> [-v seed=<seed>]
+#	[-v period=<period>] < /dev/null
+#
+# Writes `size' bytes (or a little more, cut them with head -c) of
+# `what', which is one of:
+#
+#	random		random bytes
+#	periodic	`period' random bytes over and over again
+#	table		16-byte records: a counter, a clock, a code, a name
+#	run		a single byte
+#	fibonacci	the Fibonacci word of a and b: abaababaabaab...
+#
+# The random numbers are Park-Miller's, whose products fit in the
+# mantissa of awk's doubles, so the bytes are the same with every awk
+# (under LC_ALL=C, or %c may write more than one).
+#
+
+function rand31()
+{
+	seed = (seed * 16807) % 2147483647;
+	return seed;
+}
+
+BEGIN {
+	if (seed == "")
+		seed = 1;
+	if (period == "")
+		period = 251;
+
+	if (what == "random")
+	{
+		for (n = 0; n < size; n++)
+			printf("%c", rand31() % 256);
+	} else if (what == "periodic")
+	{
+		for (i = 0; i < period; i++)
+			bytes[i] = rand31() % 256;
+		for (n = 0; n < size; n++)
+			printf("%c", bytes[n % period]);
+	} else if (what == "table")
+	{
+		stamp = 0;
+		for (n = 0; n < size; n += 16)
+		{
+			stamp += rand31() % 1000;
+			for (i = 0; i < 4; i++)
+				printf("%c", int(n / 16 / 256 ^ i) % 256);
+			for (i = 0; i < 4; i++)
+				printf("%c", int(stamp / 256 ^ i) % 256);
+			printf("%c%c", rand31() % 8, 0);
+			printf("%-6.6s", "id" (rand31() % 5000));
+		}
+	} else if (what == "run")
+	{
+		for (n = 0; n < size; n++)
+			printf("a");
+	} else if (what == "fibonacci")
+	{
+		prev = "a";
+		word = "ab";
+		while (length(word) < size)
+		{
+			next_word = word prev;
+			prev = word;
+			word = next_word;
+		}
+		printf("%s", word);
+	} else
+	{
+		printf("generate.awk: can't generate %s\n", what) > "/dev/stderr";
+		exit 1;
+	}
+
+	exit 0;
+}
+
+# End of generate.awk
@@ -1,24 +1,38 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
 
 int main(int argc, char *argv[])
 {
+	int status;
 	struct rusage ru;
+	struct timeval start, end;
 
 	if (nice(-20) < 0)
 		perror("gtr: nice");
 
+	gettimeofday(&start, NULL);
 	if (fork() == 0)
+	{
 		execvp(argv[1], &argv[1]);
-	wait3(NULL, 0, &ru);
+		perror(argv[1]);
+		_exit(127);
+	}
+	wait3(&status, 0, &ru);
+	gettimeofday(&end, NULL);
 
-	fprintf(stderr, "user time: %g\tsystem time: %g\n",
+	/* Real time and max rss last, so the columns of the others stay. */
+	fprintf(stderr, "user time: %g\tsystem time: %g"
+		"\treal time: %g\tmax rss: %ld\n",
 		(double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec
 			* 0.000001,
 		(double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec
-			* 0.000001);
-	return 0;
+			* 0.000001,
+		(double)(end.tv_sec - start.tv_sec)
+			+ (double)(end.tv_usec - start.tv_usec) * 0.000001,
+		ru.ru_maxrss);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
 }
@@ -0,0 +1,241 @@
+/*
+ * threads.c -- rings and worker threads of the pipelines
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "main.h"
+#include "threads.h"
+#include "lc_common.h"
+
+/* Function prototypes */
+static void ring_wait(struct ring_st *ring, int for_push);
+static void ring_wake(struct ring_st *ring);
+static void *worker_main(void *workerp);
+static void worker_abort(struct worker_st *worker);
+static int worker_unlink(struct worker_st *worker);
+
+/* Private variables */
+/* Workers which have been started but not joined yet.  Compressions
+ * running side by side start them from different threads. */
+static struct worker_st *workers;
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Program code */
+/* Interface functions */
+void ring_init(struct ring_st *ring)
+{
+	ring->head = ring->tail = 0;
+	ring->sleepers = ring->aborted = 0;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->cond, NULL);
+} /* ring_init */
+
+void ring_destroy(struct ring_st *ring)
+{
+	pthread_cond_destroy(&ring->cond);
+	pthread_mutex_destroy(&ring->lock);
+} /* ring_destroy */
+
+void ring_push(struct ring_st *ring, void *item)
+{
+	unsigned tail;
+
+	/* Only we write `tail'. */
+	tail = ring->tail;
+	while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)
+			== RING_SIZE)
+	{
+		if (__atomic_load_n(&ring->aborted, __ATOMIC_ACQUIRE))
+			return;
+		ring_wait(ring, 1);
+	}
+
+	ring->slots[tail % RING_SIZE] = item;
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	ring_wake(ring);
+} /* ring_push */
+
+void *ring_pop(struct ring_st *ring)
+{
+	void *item;
+	unsigned head;
+
+	head = ring->head;
+	while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head)
+	{
+		if (__atomic_load_n(&ring->aborted, __ATOMIC_ACQUIRE))
+			return NULL;
+		ring_wait(ring, 0);
+	}
+
+	item = ring->slots[head % RING_SIZE];
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	ring_wake(ring);
+
+	return item;
+} /* ring_pop */
+
+/* Makes both sides of `ring' give up waiting. */
+void ring_abort(struct ring_st *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	__atomic_store_n(&ring->aborted, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+} /* ring_abort */
+
+void worker_start(struct worker_st *worker,
+	void *(*fun)(void *), void *arg,
+	struct ring_st *ring1, struct ring_st *ring2)
+{
+	int err;
+
+	worker->fun = fun;
+	worker->arg = arg;
+	worker->rings[0] = ring1;
+	worker->rings[1] = ring2;
+
+	if ((err = pthread_create(&worker->tid, NULL,
+		worker_main, worker)) != 0)
+	{
+		logf("pthread_create: %s", strerror(err));
+		throw_exception(EXIT_ERR_OTHER);
+	}
+
+	pthread_mutex_lock(&workers_lock);
+	worker->next = workers;
+	workers = worker;
+	pthread_mutex_unlock(&workers_lock);
+} /* worker_start */
+
+/* Waits for `worker' to finish on its own.  It is a no-op if
+ * the worker has been joined already. */
+void worker_join(struct worker_st *worker)
+{
+	if (worker_unlink(worker))
+		pthread_join(worker->tid, NULL);
+} /* worker_join */
+
+/* Makes `worker' finish, wherever it is, and waits for it. */
+void worker_stop(struct worker_st *worker)
+{
+	if (!worker_unlink(worker))
+		return;
+
+	worker_abort(worker);
+	pthread_join(worker->tid, NULL);
+} /* worker_stop */
+
+/*
+ * Called when something went wrong in the main thread.  Workers may
+ * be waiting for each other's rings, so all of them are told to stop
+ * before we wait for any.
+ */
+void stop_threads(void)
+{
+	struct worker_st *worker;
+
+	pthread_mutex_lock(&workers_lock);
+	for (worker = workers; worker; worker = worker->next)
+		worker_abort(worker);
+	pthread_mutex_unlock(&workers_lock);
+
+	for (;;)
+	{
+		pthread_mutex_lock(&workers_lock);
+		worker = workers;
+		pthread_mutex_unlock(&workers_lock);
+		if (!worker)
+			break;
+		worker_join(worker);
+	}
+} /* stop_threads */
+
+/* Private functions */
+/*
+ * Sleeps until the other side of `ring' made progress.  The counter
+ * of sleepers and the positions are accessed with full barriers, so
+ * either we see the other side's progress or it sees us sleeping.
+ */
+void ring_wait(struct ring_st *ring, int for_push)
+{
+	pthread_mutex_lock(&ring->lock);
+	__atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+
+	for (;;)
+	{
+		unsigned head, tail;
+
+		if (__atomic_load_n(&ring->aborted, __ATOMIC_SEQ_CST))
+			break;
+
+		head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+		if (for_push ? tail - head < RING_SIZE : tail != head)
+			break;
+
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	}
+
+	__atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&ring->lock);
+} /* ring_wait */
+
+void ring_wake(struct ring_st *ring)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST))
+		return;
+
+	pthread_mutex_lock(&ring->lock);
+	pthread_cond_broadcast(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+} /* ring_wake */
+
+void worker_abort(struct worker_st *worker)
+{
+	unsigned i;
+
+	for (i = 0; i < MEMBS_OF(worker->rings); i++)
+		if (worker->rings[i])
+			ring_abort(worker->rings[i]);
+	pthread_cancel(worker->tid);
+} /* worker_abort */
+
+void *worker_main(void *workerp)
+{
+	struct worker_st *worker;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	worker = workerp;
+	return worker->fun(worker->arg);
+} /* worker_main */
+
+/* Returns whether `worker' was among the live ones. */
+int worker_unlink(struct worker_st *worker)
+{
+	int found;
+	struct worker_st **wp;
+
+	found = 0;
+	pthread_mutex_lock(&workers_lock);
+	for (wp = &workers; *wp; wp = &(*wp)->next)
+		if (*wp == worker)
+		{
+			*wp = worker->next;
+			found = 1;
+			break;
+		}
+	pthread_mutex_unlock(&workers_lock);
+
+	return found;
+} /* worker_unlink */
+
+/* End of threads.c */
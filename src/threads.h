@@ -0,0 +1,73 @@
+/* threads.h */
+#ifndef THREADS_H
+#define THREADS_H
+
+/* Include files */
+#include "config.h"
+
+#include <pthread.h>
+
+/* Standard definitions */
+/* Must be a power of two */
+#define RING_SIZE			16
+
+/* Macros */
+/* Lets worker_stop() cancel the calling thread while it's blocked
+ * in `call', which should be a system call returning a scalar. */
+#define CANCELLABLE(call) \
+({ \
+	int oldstate__; \
+	__typeof__(call) ret__; \
+	\
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate__); \
+	ret__ = (call); \
+	pthread_setcancelstate(oldstate__, NULL); \
+	ret__; \
+})
+
+/* Type definitions */
+/*
+ * Single-producer single-consumer queue of pointers.  The fast path
+ * is lock-free; `lock' and `cond' are only touched when one side has
+ * to wait for the other.  ring_pop() returns NULL when the producer
+ * pushed NULL (end of stream) or when the ring has been aborted.
+ */
+struct ring_st
+{
+	void *slots[RING_SIZE];
+	unsigned head, tail;
+	int sleepers, aborted;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/*
+ * A thread and the rings it may be waiting on.  Workers run with
+ * cancellation disabled; they should enable it only around blocking
+ * system calls, where they don't hold any locks.
+ */
+struct worker_st
+{
+	pthread_t tid;
+	void *(*fun)(void *);
+	void *arg;
+
+	struct ring_st *rings[2];
+	struct worker_st *next;
+};
+
+/* Function prototypes */
+extern void ring_init(struct ring_st *ring);
+extern void ring_destroy(struct ring_st *ring);
+extern void ring_push(struct ring_st *ring, void *item);
+extern void *ring_pop(struct ring_st *ring);
+extern void ring_abort(struct ring_st *ring);
+
+extern void worker_start(struct worker_st *worker,
+	void *(*fun)(void *), void *arg,
+	struct ring_st *ring1, struct ring_st *ring2);
+extern void worker_join(struct worker_st *worker);
+extern void worker_stop(struct worker_st *worker);
+
+#endif /* ! THREADS_H */
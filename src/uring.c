@@ -0,0 +1,393 @@
+/*
+ * uring.c -- asynchronous bitstream I/O through io_uring
+ *
+ * Every bitstream using this backend owns a small ring and
+ * URING_NBUFS windows.  Inputs keep all but the window being
+ * consumed in flight; outputs queue the full window and continue
+ * with the next free one, so the compute thread only waits for
+ * the disk when it is truly behind.  All requests are issued at
+ * the current file position with IOSQE_IO_DRAIN, therefore they
+ * are executed one after the other, in order, which is what pipes
+ * and O_APPEND outputs need.
+ *
+ * The raw system calls are used so that we don't depend on liburing.
+ */
+
+/* Include files */
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "uring.h"
+#include "lc_common.h"
+
+/* Standard definitions */
+enum
+{
+	URING_FREE,
+	URING_INFLIGHT,
+	URING_DONE
+};
+
+/* Type definitions */
+struct uring_st
+{
+	int fd, ringfd, output, eof;
+
+	/* Submission queue */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	/* Completion queue; may be the same mapping as sq_ring */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/*
+	 * The windows.  `cur' is the one the caller has (output)
+	 * or is the next to be handed out (input), `handed' is the
+	 * input window the caller is working on or -1.
+	 */
+	u_int8_t *bufs[URING_NBUFS];
+	int state[URING_NBUFS], res[URING_NBUFS];
+	size_t bufsize, len[URING_NBUFS];
+	unsigned cur;
+	int handed;
+};
+
+/* Function prototypes */
+static int uring_setup(struct uring_st *ur);
+static int uring_submit(struct uring_st *ur, unsigned i, size_t size);
+static void uring_reap(struct uring_st *ur);
+static int uring_wait(struct uring_st *ur, unsigned i);
+static void uring_free(struct uring_st *ur);
+
+/* Program code */
+/* Interface functions */
+/*
+ * Returns NULL if io_uring is not available for some reason,
+ * in which case the caller should stay with read()/write().
+ * Otherwise *windowp is set to the first window to use.
+ */
+struct uring_st *uring_open(int fd, size_t bufsize, int output,
+	u_int8_t **windowp)
+{
+	unsigned i;
+	struct uring_st *ur;
+
+	if (!(ur = calloc(1, sizeof(*ur))))
+		return NULL;
+
+	ur->fd = fd;
+	ur->output = output;
+	ur->bufsize = bufsize;
+	ur->handed = -1;
+	ur->ringfd = -1;
+	for (i = 0; i < MEMBS_OF(ur->bufs); i++)
+		if (!(ur->bufs[i] = malloc(bufsize)))
+			goto out;
+
+	if (!uring_setup(ur))
+		goto out;
+
+	if (!output)
+		for (i = 0; i < MEMBS_OF(ur->bufs); i++)
+			if (uring_submit(ur, i, bufsize) < 0)
+				goto out;
+
+	*windowp = ur->bufs[0];
+	return ur;
+
+out:
+	uring_close(ur);
+	return NULL;
+} /* uring_open */
+
+/*
+ * Gives back the window the caller has been reading (if any) and
+ * returns the next one in *windowp.  Returns the number of bytes in
+ * that window or -errno.
+ */
+int uring_read(struct uring_st *ur, u_int8_t **windowp)
+{
+	int err;
+	unsigned i;
+
+	if (ur->handed >= 0 && !ur->eof)
+		if ((err = uring_submit(ur, ur->handed, ur->bufsize)) < 0)
+			return err;
+	ur->handed = -1;
+
+	i = ur->cur;
+	if (ur->state[i] == URING_FREE)
+	{	/* Not resubmitted because we've seen the EOF. */
+		*windowp = ur->bufs[i];
+		return 0;
+	}
+	if ((err = uring_wait(ur, i)) < 0)
+		return err;
+
+	ur->state[i] = URING_FREE;
+	if (ur->res[i] < 0)
+		return ur->res[i];
+	if (ur->res[i] == 0)
+		ur->eof = 1;
+
+	ur->handed = i;
+	ur->cur = (i + 1) % MEMBS_OF(ur->bufs);
+	*windowp = ur->bufs[i];
+
+	return ur->res[i];
+} /* uring_read */
+
+/*
+ * Queues the first `size' bytes of the current window for writing
+ * and returns a free window in *windowp.  Returns 0 or -errno, which
+ * may be the result of an earlier write.
+ */
+int uring_write(struct uring_st *ur, u_int8_t **windowp, size_t size)
+{
+	int err;
+	unsigned i;
+
+	if (size > 0 && (err = uring_submit(ur, ur->cur, size)) < 0)
+		return err;
+
+	i = ur->cur = (ur->cur + 1) % MEMBS_OF(ur->bufs);
+	if (ur->state[i] != URING_FREE)
+	{
+		if ((err = uring_wait(ur, i)) < 0)
+			return err;
+		ur->state[i] = URING_FREE;
+		if (ur->res[i] < 0)
+			return ur->res[i];
+		if ((size_t)ur->res[i] < ur->len[i])
+			/* Later windows might have been written already,
+			 * so we can't just retry. */
+			return -EIO;
+	}
+
+	*windowp = ur->bufs[i];
+	return 0;
+} /* uring_write */
+
+/*
+ * Waits for the writes in flight, so that the file can be changed
+ * behind them.  Returns 0 or -errno, like uring_write().
+ */
+int uring_sync(struct uring_st *ur)
+{
+	int err;
+	unsigned i;
+
+	for (i = 0; i < MEMBS_OF(ur->bufs); i++)
+	{
+		if (ur->state[i] == URING_FREE)
+			continue;
+		if ((err = uring_wait(ur, i)) < 0)
+			return err;
+
+		ur->state[i] = URING_FREE;
+		if (ur->res[i] < 0)
+			return ur->res[i];
+		if ((size_t)ur->res[i] < ur->len[i])
+			return -EIO;
+	}
+
+	return 0;
+} /* uring_sync */
+
+/*
+ * Waits for all outstanding requests and releases `ur'.  For outputs
+ * returns the first error of the writes not yet reported.
+ */
+int uring_close(struct uring_st *ur)
+{
+	int err;
+	unsigned i;
+
+	err = 0;
+	for (i = 0; i < MEMBS_OF(ur->bufs); i++)
+	{
+		int ret;
+
+		if (ur->state[i] == URING_FREE)
+			continue;
+		if ((ret = uring_wait(ur, i)) < 0)
+		{	/* The kernel may still be using our buffers. */
+			if (!err)
+				err = ret;
+			ur->bufs[i] = NULL;
+			continue;
+		}
+
+		if (!ur->output || err)
+			continue;
+		if (ur->res[i] < 0)
+			err = ur->res[i];
+		else if ((size_t)ur->res[i] < ur->len[i])
+			err = -EIO;
+	}
+
+	uring_free(ur);
+	return err;
+} /* uring_close */
+
+/* Private functions */
+int uring_setup(struct uring_st *ur)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	ur->ringfd = syscall(__NR_io_uring_setup,
+		2 * MEMBS_OF(ur->bufs), &p);
+	if (ur->ringfd < 0)
+		return 0;
+
+	/* Without it we'd have to track the file positions ourselves,
+	 * which doesn't work with pipes. */
+	if (!(p.features & IORING_FEAT_RW_CUR_POS))
+		return 0;
+
+	ur->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ur->cq_ring_size = p.cq_off.cqes
+		+ p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ur->sq_ring_size = ur->cq_ring_size
+			= MAX(ur->sq_ring_size, ur->cq_ring_size);
+
+	ur->sq_ring = mmap(NULL, ur->sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ur->ringfd, IORING_OFF_SQ_RING);
+	if (ur->sq_ring == MAP_FAILED)
+	{
+		ur->sq_ring = NULL;
+		return 0;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ur->cq_ring = ur->sq_ring;
+	else
+	{
+		ur->cq_ring = mmap(NULL, ur->cq_ring_size,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ur->ringfd, IORING_OFF_CQ_RING);
+		if (ur->cq_ring == MAP_FAILED)
+		{
+			ur->cq_ring = NULL;
+			return 0;
+		}
+	}
+
+	ur->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ur->sqes = mmap(NULL, ur->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ur->ringfd, IORING_OFF_SQES);
+	if (ur->sqes == MAP_FAILED)
+	{
+		ur->sqes = NULL;
+		return 0;
+	}
+
+	ur->sq_tail = (unsigned *)((char *)ur->sq_ring + p.sq_off.tail);
+	ur->sq_mask = (unsigned *)((char *)ur->sq_ring + p.sq_off.ring_mask);
+	ur->sq_array = (unsigned *)((char *)ur->sq_ring + p.sq_off.array);
+	ur->cq_head = (unsigned *)((char *)ur->cq_ring + p.cq_off.head);
+	ur->cq_tail = (unsigned *)((char *)ur->cq_ring + p.cq_off.tail);
+	ur->cq_mask = (unsigned *)((char *)ur->cq_ring + p.cq_off.ring_mask);
+	ur->cqes = (struct io_uring_cqe *)((char *)ur->cq_ring
+		+ p.cq_off.cqes);
+
+	return 1;
+} /* uring_setup */
+
+int uring_submit(struct uring_st *ur, unsigned i, size_t size)
+{
+	unsigned tail, idx;
+	struct io_uring_sqe *sqe;
+
+	tail = *ur->sq_tail;
+	idx = tail & *ur->sq_mask;
+	sqe = &ur->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = ur->output ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->flags = IOSQE_IO_DRAIN;
+	sqe->fd = ur->fd;
+	sqe->off = (u_int64_t)-1;
+	sqe->addr = (unsigned long)ur->bufs[i];
+	sqe->len = size;
+	sqe->user_data = i;
+
+	ur->sq_array[idx] = idx;
+	__atomic_store_n(ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (syscall(__NR_io_uring_enter, ur->ringfd, 1, 0, 0, NULL, 0) < 0)
+		return -errno;
+
+	ur->state[i] = URING_INFLIGHT;
+	ur->len[i] = size;
+	return 0;
+} /* uring_submit */
+
+void uring_reap(struct uring_st *ur)
+{
+	unsigned head, tail;
+
+	head = *ur->cq_head;
+	tail = __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++)
+	{
+		struct io_uring_cqe const *cqe;
+
+		cqe = &ur->cqes[head & *ur->cq_mask];
+		ur->res[cqe->user_data] = cqe->res;
+		ur->state[cqe->user_data] = URING_DONE;
+	}
+	__atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+} /* uring_reap */
+
+int uring_wait(struct uring_st *ur, unsigned i)
+{
+	for (;;)
+	{
+		uring_reap(ur);
+		if (ur->state[i] != URING_INFLIGHT)
+			return 0;
+
+		if (syscall(__NR_io_uring_enter, ur->ringfd, 0, 1,
+				IORING_ENTER_GETEVENTS, NULL, 0) < 0
+			&& errno != EINTR)
+			return -errno;
+	}
+} /* uring_wait */
+
+void uring_free(struct uring_st *ur)
+{
+	unsigned i;
+
+	if (ur->sqes)
+		munmap(ur->sqes, ur->sqes_size);
+	if (ur->cq_ring && ur->cq_ring != ur->sq_ring)
+		munmap(ur->cq_ring, ur->cq_ring_size);
+	if (ur->sq_ring)
+		munmap(ur->sq_ring, ur->sq_ring_size);
+	if (ur->ringfd >= 0)
+		close(ur->ringfd);
+
+	for (i = 0; i < MEMBS_OF(ur->bufs); i++)
+		free(ur->bufs[i]);
+	free(ur);
+} /* uring_free */
+
+/* End of uring.c */
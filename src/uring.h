@@ -0,0 +1,26 @@
+/* uring.h */
+#ifndef URING_H
+#define URING_H
+
+/* Include files */
+#include "config.h"
+
+#include <sys/types.h>
+
+/* Standard definitions */
+/* Number of windows a bitstream can have in flight */
+#define URING_NBUFS			4
+
+/* Type definitions */
+struct uring_st;
+
+/* Function prototypes */
+extern struct uring_st *uring_open(int fd, size_t bufsize, int output,
+	u_int8_t **windowp);
+extern int uring_read(struct uring_st *ur, u_int8_t **windowp);
+extern int uring_write(struct uring_st *ur, u_int8_t **windowp,
+	size_t size);
+extern int uring_sync(struct uring_st *ur);
+extern int uring_close(struct uring_st *ur);
+
+#endif /* ! URING_H */